@@ -0,0 +1,137 @@
+// Throughput of updateCars() on synthetic ring roads, for catching regressions
+// in the car-following rules and their kernels. Build and run with `make bench`.
+//
+// Every configuration chains lanes of up to CARS_PER_LANE cars into one ring, so
+// cars driving off a lane's end re-enter the next one and the car count stays
+// fixed. Each lane has its own signal and a stop line halfway along it.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "car_kernel.h"
+#include "simulation.h"
+
+const size_t CARS_PER_LANE = 1000;
+const double TARGET_CAR_STEPS = 2e7; // Car updates timed per configuration
+const long long MIN_STEPS = 20;
+
+const size_t CAR_COUNTS[] = {10, 100, 1000, 10000, 100000, 1000000};
+// Fraction of a jammed lane's density: 1.0 leaves exactly DESIRED_CAR_GAP between cars
+const float DENSITIES[] = {0.1f, 0.5f, 0.9f};
+
+// Replace the network with a ring of lanes holding `carCount` cars in total.
+// On green the cars are spread evenly along the ring. On red they start jammed
+// bumper to bumper behind the stop lines, as queues at a light would be; driving
+// into such queues from an even spread would take tens of thousands of steps.
+static void buildRing(size_t carCount, float density, bool green) {
+    const float jamSpacing = CAR_FRONT_OFFSET + CAR_BACK_OFFSET + DESIRED_CAR_GAP;
+    float spacing = jamSpacing / density;
+    size_t laneCount = (carCount + CARS_PER_LANE - 1) / CARS_PER_LANE;
+
+    nodes.clear();
+    signals.assign(laneCount, Signal{green});
+    entryLanes.clear();
+    lanes.clear();
+    lanes.resize(laneCount);
+
+    std::vector<size_t> laneCars(laneCount);
+    size_t placed = 0;
+    for (size_t l = 0; l < laneCount; ++l) {
+        laneCars[l] = std::min(CARS_PER_LANE, carCount - placed);
+        placed += laneCars[l];
+        float length = laneCars[l] * spacing;
+
+        Lane& lane = lanes[l];
+        lane.originX = 0.0f;
+        lane.originY = 0.0f;
+        lane.directionX = 1.0f;
+        lane.directionY = 0.0f;
+        lane.spawnPosition = 0.0f;
+        lane.endPosition = length;
+        lane.stopLine = length / 2.0f;
+        lane.signal = (int)l;
+        lane.nextLane = (int)((l + 1) % laneCount);
+        // On red every car can end up queued in front of one stop line
+        lane.cars = CarQueue(2 * carCount / laneCount / density + 64);
+    }
+
+    // Lane positions of each lane's cars, lead car first once sorted
+    std::vector<std::vector<float>> positions(laneCount);
+    for (size_t l = 0; l < laneCount; ++l) {
+        for (size_t i = 0; i < laneCars[l]; ++i) {
+            if (green) {
+                positions[l].push_back(lanes[l].endPosition - (i + 0.5f) * spacing);
+                continue;
+            }
+            // A queue longer than half a lane backs up past the previous lane's stop line
+            size_t target = l;
+            float position = lanes[l].stopLine - DESIRED_CAR_GAP - CAR_FRONT_OFFSET - i * jamSpacing;
+            while (position < 0.0f) {
+                target = (target + laneCount - 1) % laneCount;
+                position += lanes[target].endPosition;
+            }
+            positions[target].push_back(position);
+        }
+    }
+
+    std::minstd_rand rng(1);
+    std::uniform_real_distribution<float> speedDist(0.003f, 0.009f);
+    for (size_t l = 0; l < laneCount; ++l) {
+        std::sort(positions[l].begin(), positions[l].end(), std::greater<float>());
+        for (float position : positions[l]) {
+            float maxSpeed = speedDist(rng);
+            lanes[l].cars.push_back(position, maxSpeed, green ? maxSpeed : 0.0f);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--scalar") {
+            setScalarCarKernel(true);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int count = std::atoi(argv[++i]);
+            threads = count > 0 ? count : std::max(1u, std::thread::hardware_concurrency());
+        } else {
+            std::printf("Usage: %s [--scalar] [--threads N]\n", argv[0]);
+            return -1;
+        }
+    }
+    setSimulationThreads(threads);
+
+    std::printf("updateCars() benchmark: %s car kernel, %u thread%s\n", carKernelName(), threads, threads == 1 ? "" : "s");
+    std::printf("%9s %8s %7s %9s %12s %14s\n", "cars", "density", "signal", "steps", "ns/car/step", "cars/second");
+
+    for (size_t carCount : CAR_COUNTS) {
+        for (float density : DENSITIES) {
+            for (int green = 1; green >= 0; --green) {
+                buildRing(carCount, density, green != 0);
+                long long steps = std::max(MIN_STEPS, (long long)(TARGET_CAR_STEPS / carCount));
+
+                // A few untimed steps, so cars settle into the rule's exact gaps and
+                // the timed run starts with warm caches
+                for (long long step = 0; step < std::min(steps / 10, 600LL); ++step)
+                    updateCars();
+
+                auto start = std::chrono::steady_clock::now();
+                for (long long step = 0; step < steps; ++step)
+                    updateCars();
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                double carSteps = (double)totalCars() * steps;
+                std::printf("%9zu %8.2f %7s %9lld %12.2f %14.4g\n", carCount, density, green ? "green" : "red",
+                            steps, elapsed * 1e9 / carSteps, carSteps / elapsed);
+            }
+        }
+    }
+    return 0;
+}
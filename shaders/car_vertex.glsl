@@ -0,0 +1,14 @@
+#version 330 core
+layout (location = 0) in vec2 aPos; // Car mesh: x along the lane, y across it
+layout (location = 1) in vec2 instancePosition;
+layout (location = 2) in vec2 instanceDirection;
+layout (location = 3) in vec3 instanceColor;
+uniform vec2 offset;
+out vec3 vertexColor;
+void main()
+{
+    vec2 across = vec2(-instanceDirection.y, instanceDirection.x);
+    vec2 position = instancePosition + instanceDirection * aPos.x + across * aPos.y;
+    gl_Position = vec4(position + offset, 0.0, 1.0);
+    vertexColor = instanceColor;
+}
\ No newline at end of file
@@ -1,7 +1,8 @@
 #version 330 core
+in vec3 vertexColor;
 out vec4 FragColor;
 uniform vec3 ourColor;
 void main()
 {
-    FragColor = vec4(ourColor, 1.0);
+    FragColor = vec4(vertexColor * ourColor, 1.0);
 }
\ No newline at end of file
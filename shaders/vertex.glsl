@@ -1,7 +1,10 @@
 #version 330 core
 layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec3 aColor;
 uniform vec2 offset;
+out vec3 vertexColor;
 void main()
 {
     gl_Position = vec4(aPos + offset, 0.0, 1.0);
+    vertexColor = aColor;
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "car_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CAR_KERNEL_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define CAR_KERNEL_NEON 1
+#endif
+
+namespace {
+
+// Values derived once per lane update and shared by every car in it
+struct KernelConstants {
+    float frontOffset;
+    float backOffset;
+    float stopTarget; // Lane coordinate the front bumper must stay behind on red
+    bool green;
+    float decelStep; // Speed lost per step while braking
+    float accelStep; // Speed gained per step while accelerating
+    float timeScale;
+    bool hasLeader;
+    float leaderPosition;
+};
+
+KernelConstants makeConstants(const LaneParams& params) {
+    KernelConstants k;
+    k.frontOffset = params.frontOffset;
+    k.backOffset = params.backOffset;
+    k.stopTarget = params.stopLine - DESIRED_CAR_GAP;
+    k.green = params.green;
+    k.decelStep = DECELERATION * params.timeScale;
+    k.accelStep = ACCELERATION * params.timeScale;
+    k.timeScale = params.timeScale;
+    k.hasLeader = params.hasLeader;
+    k.leaderPosition = params.leaderPosition;
+    return k;
+}
+
+// Scalar car-following rule for car i. `leaderPosition` is the position of car i-1
+// at the start of the step and is ignored when the car has no leader.
+// Every vector kernel below must perform exactly the same float operations.
+inline void stepCar(float* position, float* currentSpeed, const float* maxSpeed, size_t i,
+                    float leaderPosition, bool hasLeader, const KernelConstants& k) {
+    float front = position[i] + k.frontOffset;
+    bool obstacleAhead = false;
+    float obstacleDistance = -1.0f; // Initialize with a value indicating no obstacle
+
+    // Check for collision with the car ahead
+    if (hasLeader) {
+        // Distance between the front of the current car and the back of the car ahead
+        obstacleDistance = (leaderPosition - k.backOffset) - front;
+        if (obstacleDistance <= DESIRED_CAR_GAP) {
+            obstacleAhead = true;
+        }
+    }
+
+    // Check for traffic light if no immediate obstacle ahead
+    if (!k.green && !obstacleAhead) {
+        // Stop if the front of the car is at or past the stop line minus the desired gap
+        float stopLineDistance = k.stopTarget - front;
+        if (stopLineDistance <= 0.0f) {
+            obstacleAhead = true; // Treat stop line as an obstacle if at or past it
+        } else if (obstacleDistance == -1.0f || stopLineDistance < obstacleDistance) {
+            // If no car ahead, or stop line is closer, consider stop line distance
+            obstacleDistance = stopLineDistance;
+        }
+    }
+
+    // Calculate required braking distance
+    // Using a simple formula: distance = speed^2 / (2 * deceleration)
+    float speed = currentSpeed[i];
+    float requiredBrakingDistance = (speed * speed) / (2.0f * DECELERATION);
+
+    if (obstacleAhead && obstacleDistance <= requiredBrakingDistance + BRAKING_DISTANCE_BUFFER) {
+        // Decelerate if close to an obstacle or stop line
+        if (speed > 0.0f) {
+            speed -= k.decelStep;
+            if (speed < 0.0f) speed = 0.0f; // Cap at 0
+        }
+    } else {
+        // Accelerate if no obstacle or far enough away
+        if (speed < maxSpeed[i]) {
+            speed += k.accelStep;
+            if (speed > maxSpeed[i]) speed = maxSpeed[i]; // Cap at max speed
+        }
+    }
+
+    // Update position based on current speed
+    currentSpeed[i] = speed;
+    position[i] += speed * k.timeScale;
+}
+
+void updateLaneCarsScalar(float* position, float* currentSpeed, const float* maxSpeed,
+                          size_t count, const KernelConstants& k) {
+    float leaderPosition = k.leaderPosition;
+    for (size_t i = 0; i < count; ++i) {
+        float startPosition = position[i];
+        stepCar(position, currentSpeed, maxSpeed, i, leaderPosition, i > 0 || k.hasLeader, k);
+        leaderPosition = startPosition;
+    }
+}
+
+#if CAR_KERNEL_AVX2
+// 8 cars per iteration. The front car and the tail that does not fill a whole
+// vector go through stepCar(); the block loop only sees cars that have a leader.
+__attribute__((target("avx2")))
+void updateLaneCarsAvx2(float* position, float* currentSpeed, const float* maxSpeed,
+                        size_t count, const KernelConstants& k) {
+    if (count == 0)
+        return;
+
+    float leaderPosition = position[0];
+    stepCar(position, currentSpeed, maxSpeed, 0, k.leaderPosition, k.hasLeader, k);
+
+    const __m256 frontOffset = _mm256_set1_ps(k.frontOffset);
+    const __m256 backOffset = _mm256_set1_ps(k.backOffset);
+    const __m256 stopTarget = _mm256_set1_ps(k.stopTarget);
+    const __m256 desiredGap = _mm256_set1_ps(DESIRED_CAR_GAP);
+    const __m256 noObstacle = _mm256_set1_ps(-1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 brakingDivisor = _mm256_set1_ps(2.0f * DECELERATION);
+    const __m256 brakingBuffer = _mm256_set1_ps(BRAKING_DISTANCE_BUFFER);
+    const __m256 decelStep = _mm256_set1_ps(k.decelStep);
+    const __m256 accelStep = _mm256_set1_ps(k.accelStep);
+    const __m256 timeScale = _mm256_set1_ps(k.timeScale);
+    // Lane permutation that shifts the block up by one car: [x, p0, p1, ..., p6]
+    const __m256i shiftUp = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+
+    size_t i = 1;
+    for (; i + 8 <= count; i += 8) {
+        __m256 pos = _mm256_loadu_ps(position + i);
+        __m256 leader = _mm256_permutevar8x32_ps(pos, shiftUp);
+        leader = _mm256_blend_ps(leader, _mm256_set1_ps(leaderPosition), 0x01);
+        leaderPosition = position[i + 7];
+
+        __m256 front = _mm256_add_ps(pos, frontOffset);
+        __m256 gap = _mm256_sub_ps(_mm256_sub_ps(leader, backOffset), front);
+        __m256 obstacle = _mm256_cmp_ps(gap, desiredGap, _CMP_LE_OQ);
+
+        if (!k.green) {
+            __m256 stopDistance = _mm256_sub_ps(stopTarget, front);
+            __m256 atStopLine = _mm256_cmp_ps(stopDistance, zero, _CMP_LE_OQ);
+            __m256 closer = _mm256_or_ps(_mm256_cmp_ps(gap, noObstacle, _CMP_EQ_OQ),
+                                         _mm256_cmp_ps(stopDistance, gap, _CMP_LT_OQ));
+            __m256 useStopLine = _mm256_andnot_ps(obstacle, _mm256_andnot_ps(atStopLine, closer));
+            gap = _mm256_blendv_ps(gap, stopDistance, useStopLine);
+            obstacle = _mm256_or_ps(obstacle, atStopLine);
+        }
+
+        __m256 speed = _mm256_loadu_ps(currentSpeed + i);
+        __m256 limit = _mm256_loadu_ps(maxSpeed + i);
+        __m256 brakingDistance = _mm256_div_ps(_mm256_mul_ps(speed, speed), brakingDivisor);
+        __m256 braking = _mm256_and_ps(obstacle,
+            _mm256_cmp_ps(gap, _mm256_add_ps(brakingDistance, brakingBuffer), _CMP_LE_OQ));
+
+        __m256 slower = _mm256_sub_ps(speed, decelStep);
+        slower = _mm256_blendv_ps(slower, zero, _mm256_cmp_ps(slower, zero, _CMP_LT_OQ));
+        slower = _mm256_blendv_ps(speed, slower, _mm256_cmp_ps(speed, zero, _CMP_GT_OQ));
+
+        __m256 faster = _mm256_add_ps(speed, accelStep);
+        faster = _mm256_blendv_ps(faster, limit, _mm256_cmp_ps(faster, limit, _CMP_GT_OQ));
+        faster = _mm256_blendv_ps(speed, faster, _mm256_cmp_ps(speed, limit, _CMP_LT_OQ));
+
+        speed = _mm256_blendv_ps(faster, slower, braking);
+        pos = _mm256_add_ps(pos, _mm256_mul_ps(speed, timeScale));
+
+        _mm256_storeu_ps(currentSpeed + i, speed);
+        _mm256_storeu_ps(position + i, pos);
+    }
+
+    for (; i < count; ++i) {
+        float startPosition = position[i];
+        stepCar(position, currentSpeed, maxSpeed, i, leaderPosition, true, k);
+        leaderPosition = startPosition;
+    }
+}
+#endif
+
+#if CAR_KERNEL_NEON
+// 4 cars per iteration, same structure as the AVX2 kernel
+void updateLaneCarsNeon(float* position, float* currentSpeed, const float* maxSpeed,
+                        size_t count, const KernelConstants& k) {
+    if (count == 0)
+        return;
+
+    float leaderPosition = position[0];
+    stepCar(position, currentSpeed, maxSpeed, 0, k.leaderPosition, k.hasLeader, k);
+
+    const float32x4_t frontOffset = vdupq_n_f32(k.frontOffset);
+    const float32x4_t backOffset = vdupq_n_f32(k.backOffset);
+    const float32x4_t stopTarget = vdupq_n_f32(k.stopTarget);
+    const float32x4_t desiredGap = vdupq_n_f32(DESIRED_CAR_GAP);
+    const float32x4_t noObstacle = vdupq_n_f32(-1.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t brakingDivisor = vdupq_n_f32(2.0f * DECELERATION);
+    const float32x4_t brakingBuffer = vdupq_n_f32(BRAKING_DISTANCE_BUFFER);
+    const float32x4_t decelStep = vdupq_n_f32(k.decelStep);
+    const float32x4_t accelStep = vdupq_n_f32(k.accelStep);
+    const float32x4_t timeScale = vdupq_n_f32(k.timeScale);
+
+    size_t i = 1;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t pos = vld1q_f32(position + i);
+        float32x4_t leader = vextq_f32(vdupq_n_f32(leaderPosition), pos, 3);
+        leaderPosition = position[i + 3];
+
+        float32x4_t front = vaddq_f32(pos, frontOffset);
+        float32x4_t gap = vsubq_f32(vsubq_f32(leader, backOffset), front);
+        uint32x4_t obstacle = vcleq_f32(gap, desiredGap);
+
+        if (!k.green) {
+            float32x4_t stopDistance = vsubq_f32(stopTarget, front);
+            uint32x4_t atStopLine = vcleq_f32(stopDistance, zero);
+            uint32x4_t closer = vorrq_u32(vceqq_f32(gap, noObstacle), vcltq_f32(stopDistance, gap));
+            uint32x4_t useStopLine = vbicq_u32(vbicq_u32(closer, atStopLine), obstacle);
+            gap = vbslq_f32(useStopLine, stopDistance, gap);
+            obstacle = vorrq_u32(obstacle, atStopLine);
+        }
+
+        float32x4_t speed = vld1q_f32(currentSpeed + i);
+        float32x4_t limit = vld1q_f32(maxSpeed + i);
+        float32x4_t brakingDistance = vdivq_f32(vmulq_f32(speed, speed), brakingDivisor);
+        uint32x4_t braking = vandq_u32(obstacle, vcleq_f32(gap, vaddq_f32(brakingDistance, brakingBuffer)));
+
+        float32x4_t slower = vsubq_f32(speed, decelStep);
+        slower = vbslq_f32(vcltq_f32(slower, zero), zero, slower);
+        slower = vbslq_f32(vcgtq_f32(speed, zero), slower, speed);
+
+        float32x4_t faster = vaddq_f32(speed, accelStep);
+        faster = vbslq_f32(vcgtq_f32(faster, limit), limit, faster);
+        faster = vbslq_f32(vcltq_f32(speed, limit), faster, speed);
+
+        speed = vbslq_f32(braking, slower, faster);
+        pos = vaddq_f32(pos, vmulq_f32(speed, timeScale));
+
+        vst1q_f32(currentSpeed + i, speed);
+        vst1q_f32(position + i, pos);
+    }
+
+    for (; i < count; ++i) {
+        float startPosition = position[i];
+        stepCar(position, currentSpeed, maxSpeed, i, leaderPosition, true, k);
+        leaderPosition = startPosition;
+    }
+}
+#endif
+
+typedef void (*CarKernel)(float*, float*, const float*, size_t, const KernelConstants&);
+
+struct KernelChoice {
+    CarKernel kernel;
+    const char* name;
+};
+
+// Pick the widest kernel the running CPU supports
+KernelChoice detectKernel() {
+#if CAR_KERNEL_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {updateLaneCarsAvx2, "avx2"};
+#elif CAR_KERNEL_NEON
+    return {updateLaneCarsNeon, "neon"}; // NEON is part of the aarch64 baseline
+#endif
+    return {updateLaneCarsScalar, "scalar"};
+}
+
+KernelChoice activeKernel = detectKernel();
+
+} // namespace
+
+void updateLaneCars(float* position, float* currentSpeed, const float* maxSpeed,
+                    size_t count, const LaneParams& params) {
+    activeKernel.kernel(position, currentSpeed, maxSpeed, count, makeConstants(params));
+}
+
+void setScalarCarKernel(bool forceScalar) {
+    if (forceScalar)
+        activeKernel = {updateLaneCarsScalar, "scalar"};
+    else
+        activeKernel = detectKernel();
+}
+
+const char* carKernelName() {
+    return activeKernel.name;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+// Define acceleration and deceleration rates
+const float ACCELERATION = 0.0005f; // Keep acceleration the same for now
+const float DECELERATION = 0.004f; // Increased deceleration significantly
+const float BRAKING_DISTANCE_BUFFER = 1.0f; // Increased distance before obstacle to start braking
+const float DESIRED_CAR_GAP = 0.05f; // Desired minimum gap between cars
+
+// Geometry and signal state shared by every car in a lane for one update.
+// Positions are lane coordinates that grow in the direction of travel.
+struct LaneParams {
+    float frontOffset; // Distance from a car's position to its front bumper
+    float backOffset; // Distance from a car's position to its rear bumper
+    float stopLine; // Lane coordinate of the stop line
+    bool green; // Signal state for this lane
+    float timeScale; // Multiplier applied to acceleration and movement this step
+    bool hasLeader; // Whether car 0 follows a car outside this run of cars
+    float leaderPosition; // Start-of-step position of that car, if any
+};
+
+// Advance every car in a run of cars by one step. Index 0 is the front-most car;
+// it follows params.leaderPosition when params.hasLeader is set.
+// All cars react to the positions at the start of the step, so the result does
+// not depend on the order the cars are processed in; this is what lets the SIMD
+// kernels produce bit-identical results to the scalar one.
+void updateLaneCars(float* position, float* currentSpeed, const float* maxSpeed,
+                    size_t count, const LaneParams& params);
+
+// Force the portable scalar kernel (true) or let the CPU features decide (false)
+void setScalarCarKernel(bool forceScalar);
+
+// Name of the kernel updateLaneCars() currently dispatches to
+const char* carKernelName();
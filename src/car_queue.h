@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Fixed-capacity FIFO of the cars in one lane, stored as structure-of-arrays in a
+// ring. Cars only join at the back and leave from the front (index 0 is the lead
+// car), so both ends are O(1) with no element shifting and no reallocation.
+class CarQueue {
+public:
+    // A run of cars that is contiguous in memory. The queue is made of at most two.
+    struct Span {
+        float* position;
+        float* currentSpeed;
+        float* maxSpeed;
+        size_t count;
+    };
+
+    explicit CarQueue(size_t capacity = 1024) {
+        // Round up to a power of two so wrapping is a mask instead of a modulo
+        size_t rounded = 1;
+        while (rounded < capacity)
+            rounded <<= 1;
+        positions.resize(rounded);
+        currentSpeeds.resize(rounded);
+        maxSpeeds.resize(rounded);
+        entrySteps.resize(rounded);
+        entrySpeeds.resize(rounded);
+        mask = rounded - 1;
+    }
+
+    size_t size() const { return carCount; }
+    size_t capacity() const { return mask + 1; }
+    bool empty() const { return carCount == 0; }
+    bool full() const { return carCount == capacity(); }
+
+    // Append a car at the back (from standstill unless a speed is given) that
+    // entered the lane at simulation step `entryStep`. Returns false if the lane is full.
+    bool push_back(float position, float maxSpeed, float currentSpeed = 0.0f, long long entryStep = 0) {
+        if (full())
+            return false;
+        size_t index = (headIndex + carCount) & mask;
+        positions[index] = position;
+        currentSpeeds[index] = currentSpeed;
+        maxSpeeds[index] = maxSpeed;
+        entrySteps[index] = entryStep;
+        entrySpeeds[index] = currentSpeed;
+        ++carCount;
+        return true;
+    }
+
+    // Remove the lead car
+    void pop_front() {
+        headIndex = (headIndex + 1) & mask;
+        --carCount;
+    }
+
+    void clear() {
+        headIndex = 0;
+        carCount = 0;
+    }
+
+    // Per-car access, i counted from the lead car
+    float position(size_t i) const { return positions[(headIndex + i) & mask]; }
+    float currentSpeed(size_t i) const { return currentSpeeds[(headIndex + i) & mask]; }
+    float maxSpeed(size_t i) const { return maxSpeeds[(headIndex + i) & mask]; }
+    long long entryStep(size_t i) const { return entrySteps[(headIndex + i) & mask]; }
+    float entrySpeed(size_t i) const { return entrySpeeds[(headIndex + i) & mask]; }
+
+    // Split the queue into contiguous runs in lead-to-tail order. Returns how many
+    // entries of `out` were filled (0, 1 or 2).
+    int spans(Span out[2]) {
+        if (carCount == 0)
+            return 0;
+        size_t firstCount = capacity() - headIndex;
+        if (firstCount >= carCount) {
+            out[0] = spanAt(headIndex, carCount);
+            return 1;
+        }
+        out[0] = spanAt(headIndex, firstCount);
+        out[1] = spanAt(0, carCount - firstCount);
+        return 2;
+    }
+
+private:
+    Span spanAt(size_t start, size_t count) {
+        return {positions.data() + start, currentSpeeds.data() + start, maxSpeeds.data() + start, count};
+    }
+
+    std::vector<float> positions;
+    std::vector<float> currentSpeeds;
+    std::vector<float> maxSpeeds;
+    // Only read when a car passes the stop line, so kept out of the spans
+    std::vector<long long> entrySteps;
+    std::vector<float> entrySpeeds;
+    size_t headIndex = 0;
+    size_t carCount = 0;
+    size_t mask = 0;
+};
@@ -0,0 +1,263 @@
+#include "frame_capture.h"
+
+#include <glad.h>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+#include "png_writer.h"
+#include "trace.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// Quote `text` as a single argument for the shell that popen() runs
+static std::string shellQuote(const std::string& text) {
+#ifdef _WIN32
+    // cmd.exe; Windows file names cannot contain double quotes
+    return "\"" + text + "\"";
+#else
+    // Nothing is special inside single quotes, so only a quote itself needs closing and reopening
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+#endif
+}
+
+bool FrameCapture::startImages(const std::string& outputDirectory, int frameWidth, int frameHeight) {
+    if (alreadyActive())
+        return false;
+    std::error_code error;
+    std::filesystem::create_directories(outputDirectory, error);
+    if (error) {
+        std::cout << "Could not create capture directory " << outputDirectory << std::endl;
+        return false;
+    }
+    directory = outputDirectory;
+    return createTargets(frameWidth, frameHeight);
+}
+
+bool FrameCapture::startVideo(const std::string& videoFile, int frameWidth, int frameHeight) {
+    if (alreadyActive())
+        return false;
+#ifndef _WIN32
+    // If ffmpeg exits early, a failed write should be reported, not kill the process
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+    std::string command = "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s " +
+                          std::to_string(frameWidth) + "x" + std::to_string(frameHeight) +
+                          " -r 60 -i - -pix_fmt yuv420p " + shellQuote(videoFile);
+#ifdef _WIN32
+    videoPipe = popen(command.c_str(), "wb");
+#else
+    videoPipe = popen(command.c_str(), "w");
+#endif
+    if (!videoPipe) {
+        std::cout << "Could not start ffmpeg" << std::endl;
+        return false;
+    }
+    return createTargets(frameWidth, frameHeight);
+}
+
+// Starting over a running capture would leak its targets and its writer thread
+bool FrameCapture::alreadyActive() const {
+    if (active())
+        std::cout << "Frame capture is already running" << std::endl;
+    return active();
+}
+
+bool FrameCapture::createTargets(int frameWidth, int frameHeight) {
+    if (alreadyActive())
+        return false;
+    width = frameWidth;
+    height = frameHeight;
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::cout << "Capture framebuffer is incomplete" << std::endl;
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        framebuffer = colorBuffer = 0;
+        if (videoPipe)
+            pclose(videoPipe);
+        videoPipe = nullptr;
+        return false;
+    }
+
+    glGenBuffers(READBACK_DEPTH, packBuffers);
+    for (int i = 0; i < READBACK_DEPTH; ++i) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    frameCount = 0;
+    droppedFrames = 0;
+    stopping = false;
+    writeFailed = false;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+    return true;
+}
+
+void FrameCapture::beginFrame() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+void FrameCapture::endFrame(int windowWidth, int windowHeight) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    // The buffer this frame reuses was read READBACK_DEPTH frames ago, so its
+    // copy has almost certainly finished by now
+    int slot = (int)(frameCount % READBACK_DEPTH);
+    if (fences[slot])
+        collect(slot);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[slot]);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0); // Returns at once; the copy is queued
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slotFrames[slot] = frameCount++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Map a finished readback and hand its pixels to the writer thread
+void FrameCapture::collect(int slot) {
+    TraceZone zone("captureReadback");
+    GLsync fence = (GLsync)fences[slot];
+    while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+    }
+    glDeleteSync(fence);
+    fences[slot] = nullptr;
+
+    std::vector<unsigned char> pixels;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !spareBuffers.empty() || allocatedBuffers < MAX_QUEUED_FRAMES; });
+        if (!spareBuffers.empty()) {
+            pixels = std::move(spareBuffers.back());
+            spareBuffers.pop_back();
+        } else {
+            ++allocatedBuffers;
+        }
+    }
+    size_t rowBytes = (size_t)width * 4;
+    pixels.resize(rowBytes * height);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[slot]);
+    const unsigned char* mapped = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rowBytes * height, GL_MAP_READ_BIT);
+    if (mapped) {
+        // GL rows run bottom to top; images run top to bottom
+        for (int y = 0; y < height; ++y)
+            std::memcpy(&pixels[y * rowBytes], mapped + (height - 1 - y) * rowBytes, rowBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        std::cout << "Could not read back frame " << slotFrames[slot] << ", it will be missing" << std::endl;
+        ++droppedFrames;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (mapped)
+        queued.push_back({slotFrames[slot], std::move(pixels)});
+    else
+        spareBuffers.push_back(std::move(pixels));
+    changed.notify_all();
+}
+
+void FrameCapture::finish() {
+    if (!active())
+        return;
+
+    // Oldest first, so frames reach the writer in order
+    for (long long frame = frameCount - READBACK_DEPTH; frame < frameCount; ++frame) {
+        int slot = (int)(frame % READBACK_DEPTH);
+        if (frame >= 0 && fences[slot])
+            collect(slot);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    writer.join();
+    if (videoPipe)
+        pclose(videoPipe);
+    videoPipe = nullptr;
+
+    glDeleteBuffers(READBACK_DEPTH, packBuffers);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    framebuffer = colorBuffer = 0;
+    spareBuffers.clear();
+    allocatedBuffers = 0;
+
+    std::cout << "Captured " << frameCount << " frames";
+    if (droppedFrames > 0)
+        std::cout << ", " << droppedFrames << " of them could not be read back";
+    std::cout << std::endl;
+}
+
+void FrameCapture::writerLoop() {
+    setTraceThreadName("capture writer");
+    for (;;) {
+        Frame frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (queued.empty())
+                return;
+            frame = std::move(queued.front());
+            queued.pop_front();
+        }
+
+        writeFrame(frame);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        spareBuffers.push_back(std::move(frame.pixels));
+        changed.notify_all();
+    }
+}
+
+void FrameCapture::writeFrame(const Frame& frame) {
+    TraceZone zone("writeFrame");
+    if (writeFailed)
+        return;
+
+    if (videoPipe) {
+        if (fwrite(frame.pixels.data(), 1, frame.pixels.size(), videoPipe) != frame.pixels.size()) {
+            std::cout << "ffmpeg stopped accepting frames at frame " << frame.index << std::endl;
+            writeFailed = true;
+        }
+        return;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06lld.png", frame.index);
+    std::string path = (std::filesystem::path(directory) / name).string();
+    if (!writePng(path, frame.pixels.data(), width, height)) {
+        std::cout << "Could not write " << path << std::endl;
+        writeFailed = true;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records what the renderer draws. Each frame is drawn into an offscreen
+// framebuffer, copied to the window, and read back into one of a ring of pixel
+// buffer objects. A buffer is only mapped READBACK_DEPTH frames later, once its
+// fence has signalled, so glReadPixels never stalls the render loop. A writer
+// thread then encodes the frames as numbered PNGs or pipes them to ffmpeg.
+class FrameCapture {
+public:
+    static const int READBACK_DEPTH = 3;
+    static const int MAX_QUEUED_FRAMES = 8; // Beyond this the render loop waits for the writer
+
+    // Write directory/frame_000000.png, frame_000001.png, ... Needs a current GL context.
+    bool startImages(const std::string& directory, int width, int height);
+    // Pipe raw frames to ffmpeg (from the PATH), which encodes them into `videoFile`
+    bool startVideo(const std::string& videoFile, int width, int height);
+    // Write out every frame still in flight and stop the writer thread
+    void finish();
+
+    bool active() const { return framebuffer != 0; }
+    long long framesCaptured() const { return frameCount; }
+
+    // Draw into the capture framebuffer until endFrame()
+    void beginFrame();
+    // Copy the frame to the window's back buffer and queue its readback
+    void endFrame(int windowWidth, int windowHeight);
+
+private:
+    struct Frame {
+        long long index;
+        std::vector<unsigned char> pixels; // RGBA, rows top to bottom
+    };
+
+    bool alreadyActive() const;
+    bool createTargets(int width, int height);
+    void collect(int slot);
+    void writerLoop();
+    void writeFrame(const Frame& frame);
+
+    int width = 0;
+    int height = 0;
+    unsigned int framebuffer = 0;
+    unsigned int colorBuffer = 0;
+    unsigned int packBuffers[READBACK_DEPTH] = {};
+    void* fences[READBACK_DEPTH] = {};
+    long long slotFrames[READBACK_DEPTH] = {};
+    long long frameCount = 0;
+    long long droppedFrames = 0; // Frames whose readback could not be mapped
+
+    std::string directory;
+    FILE* videoPipe = nullptr;
+    bool writeFailed = false; // Only touched by the writer thread
+
+    // Handed between the render thread and the writer thread
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Frame> queued;
+    std::vector<std::vector<unsigned char>> spareBuffers;
+    int allocatedBuffers = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,87 @@
+#include "frame_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+FrameProfiler frameProfiler;
+
+static const char* PHASE_NAMES[PHASE_COUNT] = {"input", "update_cars", "spawn", "render", "swap"};
+
+const char* phaseName(ProfilePhase phase) {
+    return PHASE_NAMES[phase];
+}
+
+void FrameProfiler::endFrame(double frameSeconds) {
+    // Seconds per phase. A step running right now lands in the next frame.
+    double totals[PHASE_COUNT];
+    for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+        std::chrono::steady_clock::duration time(pending[phase].exchange(0, std::memory_order_relaxed));
+        totals[phase] = std::chrono::duration<double>(time).count();
+    }
+    int steps = pendingCount[PHASE_UPDATE_CARS].exchange(0, std::memory_order_relaxed);
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        pendingCount[phase].store(0, std::memory_order_relaxed);
+
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        history[phase][historyNext] = (float)(totals[phase] * 1000.0);
+    history[PHASE_COUNT][historyNext] = (float)(frameSeconds * 1000.0);
+    historyNext = (historyNext + 1) % WINDOW;
+    historySize = std::min(historySize + 1, WINDOW);
+    elapsed += frameSeconds;
+
+    if (csv.is_open()) {
+        csv << frameIndex << ',' << elapsed << ',' << steps;
+        for (int phase = 0; phase < PHASE_COUNT; ++phase)
+            csv << ',' << totals[phase] * 1000.0;
+        csv << ',' << frameSeconds * 1000.0 << '\n';
+    }
+    ++frameIndex;
+}
+
+PhaseStats FrameProfiler::statsOf(int row) const {
+    if (historySize == 0)
+        return {0.0, 0.0, 0.0};
+    float sorted[WINDOW];
+    std::copy(history[row], history[row] + historySize, sorted);
+    std::sort(sorted, sorted + historySize);
+    double sum = 0.0;
+    for (int i = 0; i < historySize; ++i)
+        sum += sorted[i];
+    int p99 = std::max(0, (int)std::ceil(historySize * 0.99) - 1);
+    return {sorted[0], sum / historySize, sorted[p99]};
+}
+
+PhaseStats FrameProfiler::stats(ProfilePhase phase) const {
+    return statsOf(phase);
+}
+
+PhaseStats FrameProfiler::frameStats() const {
+    return statsOf(PHASE_COUNT);
+}
+
+bool FrameProfiler::openCsv(const std::string& path) {
+    csv.open(path, std::ios::trunc);
+    if (!csv) {
+        std::cout << "Could not open profile file " << path << std::endl;
+        return false;
+    }
+    csv << "frame,time_s,steps";
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        csv << ',' << PHASE_NAMES[phase] << "_ms";
+    csv << ",frame_ms\n";
+    return true;
+}
+
+void FrameProfiler::printSummary() const {
+    std::cout << "Frame profile over the last " << historySize << " frames (ms):" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    for (int row = 0; row <= PHASE_COUNT; ++row) {
+        PhaseStats phase = statsOf(row);
+        std::cout << "  " << std::left << std::setw(12) << (row < PHASE_COUNT ? PHASE_NAMES[row] : "frame")
+                  << std::right << " min " << std::setw(8) << phase.min << "  avg " << std::setw(8) << phase.average
+                  << "  p99 " << std::setw(8) << phase.p99 << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "trace.h"
+
+// The parts of a frame that are timed. Updating cars and spawning happen on the
+// simulation thread; their per-frame figures are the time spent on them since
+// the previous frame, summed over however many steps ran.
+enum ProfilePhase {
+    PHASE_INPUT, // processInput() and glfwPollEvents()
+    PHASE_UPDATE_CARS,
+    PHASE_SPAWN,
+    PHASE_RENDER, // renderScene() and the overlay
+    PHASE_SWAP, // glfwSwapBuffers(), including any wait for vsync
+    PHASE_COUNT
+};
+
+const char* phaseName(ProfilePhase phase);
+
+// Rolling statistics over the last FrameProfiler::WINDOW frames, in milliseconds
+struct PhaseStats {
+    double min, average, p99;
+};
+
+// Collects how long each phase took, frame by frame. record() may be called
+// from any thread; everything else belongs to the render thread. Disabled until
+// setEnabled(true), so headless runs do not pay for the clock reads.
+class FrameProfiler {
+public:
+    static const int WINDOW = 240; // Four seconds at 60 frames per second
+
+    void setEnabled(bool on) { enabledFlag.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabledFlag.load(std::memory_order_relaxed); }
+
+    void record(ProfilePhase phase, std::chrono::steady_clock::duration time) {
+        pending[phase].fetch_add(time.count(), std::memory_order_relaxed);
+        pendingCount[phase].fetch_add(1, std::memory_order_relaxed);
+    }
+    // Close the current frame: its per-phase totals join the rolling window and,
+    // if a CSV is open, are written as one row
+    void endFrame(double frameSeconds);
+
+    PhaseStats stats(ProfilePhase phase) const;
+    PhaseStats frameStats() const;
+
+    // Start writing one row per frame to `path`
+    bool openCsv(const std::string& path);
+    void printSummary() const;
+
+private:
+    PhaseStats statsOf(int row) const;
+
+    std::atomic<bool> enabledFlag{false};
+    // Time (in steady_clock ticks) and calls since the last endFrame()
+    std::atomic<long long> pending[PHASE_COUNT] = {};
+    std::atomic<int> pendingCount[PHASE_COUNT] = {};
+
+    // Milliseconds per frame; the last row holds the whole frame
+    float history[PHASE_COUNT + 1][WINDOW] = {};
+    int historySize = 0;
+    int historyNext = 0;
+    long long frameIndex = 0;
+    double elapsed = 0.0;
+    std::ofstream csv;
+};
+
+extern FrameProfiler frameProfiler;
+
+// Times the enclosing block as `phase`, if the profiler is enabled, and traces
+// it as a zone of the same name
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfilePhase phase)
+        : phase(phase), active(frameProfiler.enabled()), zone(phaseName(phase)) {
+        if (active)
+            start = std::chrono::steady_clock::now();
+    }
+    ~ProfileScope() {
+        if (active)
+            frameProfiler.record(phase, std::chrono::steady_clock::now() - start);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ProfilePhase phase;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+    TraceZone zone;
+};
@@ -0,0 +1,62 @@
+#include "latency_histogram.h"
+
+#include <cstdio>
+
+LatencyHistogram frameTimes;
+LatencyHistogram stepTimes;
+
+// Values below SUB_BUCKETS get a bucket each. Above that, a value with its top
+// bit at `exponent` lands in the block for that exponent, at its next
+// SUB_BUCKET_BITS bits.
+int LatencyHistogram::bucketOf(long long nanoseconds) {
+    if (nanoseconds < SUB_BUCKETS)
+        return nanoseconds < 0 ? 0 : (int)nanoseconds;
+    int exponent = 63 - __builtin_clzll((unsigned long long)nanoseconds);
+    if (exponent > MAX_EXPONENT)
+        return BUCKET_COUNT - 1;
+    int shift = exponent - SUB_BUCKET_BITS;
+    int subBucket = (int)(nanoseconds >> shift) - SUB_BUCKETS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + subBucket;
+}
+
+long long LatencyHistogram::bucketMiddle(int bucket) {
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    long long lowest = (long long)(SUB_BUCKETS + (bucket - SUB_BUCKETS) % SUB_BUCKETS) << shift;
+    return lowest + ((1LL << shift) >> 1);
+}
+
+unsigned long long LatencyHistogram::count() const {
+    unsigned long long total = 0;
+    for (const auto& bucket : counts)
+        total += bucket.load(std::memory_order_relaxed);
+    return total;
+}
+
+long long LatencyHistogram::percentile(double fraction) const {
+    unsigned long long total = count();
+    if (total == 0)
+        return 0;
+    // The rank of the value asked for, counting from 1
+    unsigned long long rank = (unsigned long long)(fraction * total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    unsigned long long seen = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += counts[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            long long middle = bucketMiddle(bucket);
+            return middle < max() ? middle : max();
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::print(const char* label, const char* unit, double nanosecondsPerUnit) const {
+    std::printf("%s (%llu): p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f %s\n", label, count(),
+                percentile(0.5) / nanosecondsPerUnit, percentile(0.9) / nanosecondsPerUnit,
+                percentile(0.99) / nanosecondsPerUnit, percentile(0.999) / nanosecondsPerUnit,
+                max() / nanosecondsPerUnit, unit);
+    std::fflush(stdout);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+// Counts of durations in logarithmic buckets, HdrHistogram style: each power of
+// two of nanoseconds is split into SUB_BUCKETS linear buckets, so every value
+// from 1 ns to over a day is kept to within 1/SUB_BUCKETS in a fixed table.
+// record() only bumps one counter; it never allocates, locks or sorts, so the
+// histograms stay on all the time. One thread records into a histogram, and any
+// thread may read percentiles from it meanwhile.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 6;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_EXPONENT = 47; // Values are clamped to under 2^48 ns (about 78 hours)
+    static const int BUCKET_COUNT = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(std::chrono::steady_clock::duration time) {
+        long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+        std::atomic<unsigned long long>& bucket = counts[bucketOf(nanoseconds)];
+        // Only this thread writes, so a plain load and store is enough
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (nanoseconds > largest.load(std::memory_order_relaxed))
+            largest.store(nanoseconds, std::memory_order_relaxed);
+    }
+
+    unsigned long long count() const;
+    // Nanoseconds below which `fraction` (0..1) of the recorded values fall,
+    // to within one bucket
+    long long percentile(double fraction) const;
+    long long max() const { return largest.load(std::memory_order_relaxed); }
+
+    // One line with the count, p50, p90, p99, p99.9 and max, in `unit`
+    // (e.g. "ms" with 1e6 nanoseconds per unit)
+    void print(const char* label, const char* unit, double nanosecondsPerUnit) const;
+
+private:
+    static int bucketOf(long long nanoseconds);
+    static long long bucketMiddle(int bucket);
+
+    std::atomic<unsigned long long> counts[BUCKET_COUNT] = {};
+    std::atomic<long long> largest{0};
+};
+
+extern LatencyHistogram frameTimes; // Render loop, one value per frame
+extern LatencyHistogram stepTimes; // One value per simulation step
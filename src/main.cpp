@@ -5,65 +5,76 @@
 #include <chrono>
 #include <cmath> // For std::abs
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-
-struct Car {
-    float x, y;
-    float speed; // This will now be maxSpeed
-    float currentSpeed; // Add current speed
-    int direction; // 0 = horizontal, 1 = vertical
-};
-
-struct TextureInfo {
-    unsigned int id;
-    int width;
-    int height;
-};
-
-std::vector<Car> horizontalCars;
-std::vector<Car> verticalCars;
-
-bool horizontalGreen = true;
-bool verticalGreen = false;
-
-float simulationSpeed = 1.0f;
-
-// Define acceleration and deceleration rates
-const float ACCELERATION = 0.0005f; // Keep acceleration the same for now
-const float DECELERATION = 0.004f; // Increased deceleration significantly
-const float BRAKING_DISTANCE_BUFFER = 1.0f; // Increased distance before obstacle to start braking
-const float DESIRED_CAR_GAP = 0.05f; // Desired minimum gap between cars
+#include "car_kernel.h"
+#include "frame_capture.h"
+#include "frame_profiler.h"
+#include "latency_histogram.h"
+#include "renderer.h"
+#include "simulation.h"
+#include "snapshot_exchange.h"
+#include "stream_buffer.h"
+#include "trace.h"
+#include "traffic_kpi.h"
+
+std::atomic<float> simulationSpeed{1.0f}; // Simulated seconds per real second
+const int MAX_SUBSTEPS_PER_BATCH = 500; // Beyond this the sim drops time instead of falling behind
+
+// In windowed mode the simulation runs on its own thread. The render thread only
+// ever sees the snapshots it publishes and sends input back through these atomics.
+std::atomic<bool> simulationRunning{false};
+std::atomic<int> pendingSignalToggles{0};
+SnapshotExchange snapshots;
 
 // Add key state flags
 bool key1Pressed = false;
 bool key2Pressed = false;
 // Add a flag for traffic light toggle
 bool lightTogglePressed = false;
-
-// Variables for random car generation
-std::mt19937 rng(std::chrono::steady_clock::now().time_since_epoch().count());
-std::uniform_real_distribution<float> spawnChanceDist(0.0f, 1.0f);
-std::uniform_int_distribution<int> carTypeDist(0, 1);
-// Add distribution for random speed
-std::uniform_real_distribution<float> carSpeedDist(0.003f, 0.009f); // Range for car speeds
-
-double lastSpawnTime = glfwGetTime();
-double spawnInterval = 0.5; // seconds between spawn attempts
-float spawnProbability = 0.7; // probability of spawning a car when interval is met
-
-// Texture IDs
-// unsigned int texture1;
-// unsigned int texture2;
-
-// Texture Info
-TextureInfo texture1Info;
-TextureInfo texture2Info;
+// Frame profiler overlay, toggled with the P key
+bool profilerOverlayVisible = false;
+bool profilerTogglePressed = false;
+bool histogramKeyPressed = false;
+std::string profileCsvFile; // Per-frame phase timings are written here when set
+std::string trafficCsvFile; // Per-approach traffic measures are written here at exit when set
+std::string traceFile; // Chrome trace JSON of every thread's zones is written here when set
+
+std::string scenarioName = "crossing";
+int gridSize = 10; // Intersections per side for the grid scenario
+unsigned simulationThreads = 1;
+double arrivalRateOption = -1.0; // Cars per second per entry lane; negative keeps the default
+
+// Recording: --capture writes numbered PNGs, --capture-video pipes frames to ffmpeg
+std::string captureDirectory;
+std::string captureVideoFile;
+long long captureFrameLimit = 0; // Close the window after this many frames; 0 records until it is closed
+const double CAPTURE_FRAME_TIME = 1.0 / 60.0;
+FrameCapture frameCapture;
+double recordingAccumulator = 0.0;
+
+// Headless mode: run the simulation without a window and report throughput
+bool headlessMode = false;
+long long headlessSteps = 100000; // Number of steps to run in headless mode
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
+void printLatencies() {
+    if (frameTimes.count() > 0)
+        frameTimes.print("Frame times", "ms", 1e6);
+    stepTimes.print("Step times", "us", 1e3);
+}
+
+// One simulation step, with its duration added to the step histogram. `start`
+// is when the step began and is moved on to when it ended, so back-to-back
+// steps need only one clock read each.
+void timedStep(std::chrono::steady_clock::time_point& start) {
+    stepSimulation();
+    auto end = std::chrono::steady_clock::now();
+    stepTimes.record(end - start);
+    start = end;
+}
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -78,463 +89,241 @@ void processInput(GLFWwindow *window) {
     }
     */
 
-    // Toggle traffic lights with Spacebar
+    // Toggle traffic lights with the A key
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS && !lightTogglePressed) {
-        if (horizontalGreen) {
-            horizontalGreen = false;
-            verticalGreen = true;
-        } else {
-            horizontalGreen = true;
-            verticalGreen = false;
-        }
+        ++pendingSignalToggles; // Applied by the simulation thread before its next step
         lightTogglePressed = true;
     }
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_RELEASE) {
         lightTogglePressed = false;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-        simulationSpeed += 0.01f;
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && simulationSpeed > 0.01f)
-        simulationSpeed -= 0.01f;
-}
-
-void drawRectangle(float x, float y, float width, float height, float r, float g, float b) {
-    glColor3f(r, g, b);
-    glBegin(GL_QUADS);
-        glVertex2f(x, y);
-        glVertex2f(x + width, y);
-        glVertex2f(x + width, y + height);
-        glVertex2f(x, y + height);
-    glEnd();
-}
-
-void renderScene() {
-    // Clear screen
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    // Draw background (grass)
-    glColor3f(0.2f, 0.5f, 0.1f); // Green color for grass
-    glBegin(GL_QUADS);
-        glVertex2f(-1.0f, -1.0f); // Bottom-left
-        glVertex2f(1.0f, -1.0f);  // Bottom-right
-        glVertex2f(1.0f, 1.0f);   // Top-right
-        glVertex2f(-1.0f, 1.0f);  // Top-left
-    glEnd();
-
-    // Draw roads
-    drawRectangle(-1.0f, -0.1f, 2.0f, 0.2f, 0.2f, 0.2f, 0.2f); // Horizontal
-    drawRectangle(-0.1f, -1.0f, 0.2f, 2.0f, 0.2f, 0.2f, 0.2f); // Vertical
-
-    // Draw lane lines
-    glColor3f(1.0f, 1.0f, 1.0f); // White color for lane lines
-    glBegin(GL_LINES);
-        // Horizontal lane lines
-        glVertex2f(-1.0f, 0.0f); // Left end of middle line
-        glVertex2f(1.0f, 0.0f);  // Right end of middle line
-
-        // Vertical lane lines
-        glVertex2f(0.0f, -1.0f); // Bottom end of middle line
-        glVertex2f(0.0f, 1.0f);  // Top end of middle line
-    glEnd();
-
-    // Draw crosswalks
-    glColor3f(1.0f, 1.0f, 1.0f); // White color for crosswalks
-    glBegin(GL_QUADS);
-        // Top crosswalk
-        glVertex2f(-0.1f, 0.1f); glVertex2f(0.1f, 0.1f); glVertex2f(0.1f, 0.15f); glVertex2f(-0.1f, 0.15f);
-        glVertex2f(-0.1f, 0.2f); glVertex2f(0.1f, 0.2f); glVertex2f(0.1f, 0.25f); glVertex2f(-0.1f, 0.25f);
-
-        // Bottom crosswalk
-        glVertex2f(-0.1f, -0.1f); glVertex2f(0.1f, -0.1f); glVertex2f(0.1f, -0.15f); glVertex2f(-0.1f, -0.15f);
-        glVertex2f(-0.1f, -0.2f); glVertex2f(0.1f, -0.2f); glVertex2f(0.1f, -0.25f); glVertex2f(-0.1f, -0.25f);
-
-        // Left crosswalk
-        glVertex2f(-0.1f, -0.1f); glVertex2f(-0.15f, -0.1f); glVertex2f(-0.15f, 0.1f); glVertex2f(-0.1f, 0.1f);
-        glVertex2f(-0.2f, -0.1f); glVertex2f(-0.25f, -0.1f); glVertex2f(-0.25f, 0.1f); glVertex2f(-0.2f, 0.1f);
-
-        // Right crosswalk
-        glVertex2f(0.1f, -0.1f); glVertex2f(0.15f, -0.1f); glVertex2f(0.15f, 0.1f); glVertex2f(0.1f, 0.1f);
-        glVertex2f(0.2f, -0.1f); glVertex2f(0.25f, -0.1f); glVertex2f(0.25f, 0.1f); glVertex2f(0.2f, 0.1f);
-    glEnd();
-
-    // Draw simple trees (refined shapes)
-    glColor3f(0.5f, 0.35f, 0.05f); // Brown color for trunks
-    glBegin(GL_QUADS);
-        glVertex2f(-0.7f, 0.4f); glVertex2f(-0.75f, 0.4f); glVertex2f(-0.75f, 0.55f); glVertex2f(-0.7f, 0.55f);
-        glVertex2f(0.6f, -0.5f); glVertex2f(0.55f, -0.5f); glVertex2f(0.55f, -0.35f); glVertex2f(0.6f, -0.35f);
-    glEnd();
-
-    glColor3f(0.1f, 0.6f, 0.1f); // Green color for tree tops (using triangles for a more rounded look)
-    glBegin(GL_TRIANGLES);
-        glVertex2f(-0.725f, 0.7f); glVertex2f(-0.85f, 0.55f); glVertex2f(-0.6f, 0.55f); // Top triangle
-        glVertex2f(-0.725f, 0.6f); glVertex2f(-0.8f, 0.45f); glVertex2f(-0.65f, 0.45f); // Middle triangle
-
-        glVertex2f(0.575f, -0.2f); glVertex2f(0.45f, -0.35f); glVertex2f(0.7f, -0.35f); // Top triangle
-        glVertex2f(0.575f, -0.3f); glVertex2f(0.5f, -0.45f); glVertex2f(0.65f, -0.45f); // Middle triangle
-    glEnd();
-
-    // Draw simple lampposts
-    glColor3f(1.0f, 1.0f, 0.0f); // Yellow color for lamppost lights
-    glBegin(GL_QUADS);
-        glVertex2f(-0.22f, 0.8f); glVertex2f(-0.16f, 0.8f); glVertex2f(-0.16f, 0.83f); glVertex2f(-0.22f, 0.83f);
-        glVertex2f(0.16f, -0.8f); glVertex2f(0.22f, -0.8f); glVertex2f(0.22f, -0.83f); glVertex2f(0.16f, -0.83f);
-    glEnd();
-
-    // Draw buildings
-    // Building 1 (Top-left)
-    glColor3f(0.7f, 0.7f, 0.7f); // Wall color
-    glBegin(GL_QUADS);
-        glVertex2f(-0.9f, 0.5f); glVertex2f(-0.6f, 0.5f); glVertex2f(-0.6f, 0.9f); glVertex2f(-0.9f, 0.9f);
-    glEnd();
-    glColor3f(0.4f, 0.4f, 0.5f); // Window color
-    glBegin(GL_QUADS);
-        glVertex2f(-0.85f, 0.55f); glVertex2f(-0.8f, 0.55f); glVertex2f(-0.8f, 0.85f); glVertex2f(-0.85f, 0.85f);
-        glVertex2f(-0.75f, 0.55f); glVertex2f(-0.7f, 0.55f); glVertex2f(-0.7f, 0.85f); glVertex2f(-0.75f, 0.85f);
-    glEnd();
-
-    // Building 2 (Bottom-right)
-    glColor3f(0.8f, 0.5f, 0.5f); // Wall color
-    glBegin(GL_QUADS);
-        glVertex2f(0.6f, -0.9f); glVertex2f(0.9f, -0.9f); glVertex2f(0.9f, -0.5f); glVertex2f(0.6f, -0.5f);
-    glEnd();
-     glColor3f(0.4f, 0.5f, 0.4f); // Window color
-    glBegin(GL_QUADS);
-        glVertex2f(0.65f, -0.85f); glVertex2f(0.7f, -0.85f); glVertex2f(0.7f, -0.55f); glVertex2f(0.65f, -0.55f);
-        glVertex2f(0.75f, -0.85f); glVertex2f(0.8f, -0.85f); glVertex2f(0.8f, -0.55f); glVertex2f(0.75f, -0.55f);
-        glVertex2f(0.85f, -0.85f); glVertex2f(0.9f, -0.85f); glVertex2f(0.9f, -0.55f); glVertex2f(0.85f, -0.55f);
-    glEnd();
-
-    // Building 3 (Bottom-left, smaller)
-    glColor3f(0.5f, 0.5f, 0.8f); // Wall color
-    glBegin(GL_QUADS);
-        glVertex2f(-0.95f, -0.95f); glVertex2f(-0.8f, -0.95f); glVertex2f(-0.8f, -0.7f); glVertex2f(-0.95f, -0.7f);
-    glEnd();
-     glColor3f(0.3f, 0.3f, 0.4f); // Window color
-    glBegin(GL_QUADS);
-        glVertex2f(-0.9f, -0.9f); glVertex2f(-0.85f, -0.9f); glVertex2f(-0.85f, -0.75f); glVertex2f(-0.9f, -0.75f);
-    glEnd();
-
-     // Building 4 (Top-right, taller)
-    glColor3f(0.5f, 0.8f, 0.5f); // Wall color
-    glBegin(GL_QUADS);
-        glVertex2f(0.7f, 0.6f); glVertex2f(0.95f, 0.6f); glVertex2f(0.95f, 0.95f); glVertex2f(0.7f, 0.95f);
-    glEnd();
-     glColor3f(0.4f, 0.6f, 0.4f); // Window color
-    glBegin(GL_QUADS);
-        glVertex2f(0.75f, 0.65f); glVertex2f(0.8f, 0.65f); glVertex2f(0.8f, 0.9f); glVertex2f(0.75f, 0.9f);
-        glVertex2f(0.85f, 0.65f); glVertex2f(0.9f, 0.65f); glVertex2f(0.9f, 0.9f); glVertex2f(0.85f, 0.9f);
-    glEnd();
-
-    // Draw traffic lights (larger)
-    drawRectangle(0.3f, 0.1f, 0.1f, 0.1f, horizontalGreen ? 0.0f : 1.0f, horizontalGreen ? 1.0f : 0.0f, 0.0f); // Horizontal light
-    drawRectangle(0.1f, 0.3f, 0.1f, 0.1f, verticalGreen ? 0.0f : 1.0f, verticalGreen ? 1.0f : 0.0f, 0.0f); // Vertical light
-
-    // Draw horizontal cars (larger)
-    for (auto& car : horizontalCars) {
-        glColor3f(1.0f, 0.0f, 0.0f); // Red color for horizontal cars
-        glBegin(GL_QUADS); // Using QUADS for a slightly more complex shape
-            // Main body
-            glVertex2f(car.x, car.y + 0.02f); // Bottom-left of main body
-            glVertex2f(car.x + 0.15f, car.y + 0.02f); // Bottom-right of main body
-            glVertex2f(car.x + 0.15f, car.y + 0.08f); // Top-right of main body
-            glVertex2f(car.x, car.y + 0.08f); // Top-left of main body
-
-            // Front (hood)
-            glVertex2f(car.x + 0.15f, car.y + 0.03f);
-            glVertex2f(car.x + 0.18f, car.y + 0.03f);
-            glVertex2f(car.x + 0.18f, car.y + 0.07f);
-            glVertex2f(car.x + 0.15f, car.y + 0.07f);
-
-            // Back (trunk)
-            glVertex2f(car.x - 0.03f, car.y + 0.03f);
-            glVertex2f(car.x, car.y + 0.03f);
-            glVertex2f(car.x, car.y + 0.07f);
-            glVertex2f(car.x - 0.03f, car.y + 0.07f);
-        glEnd();
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !profilerTogglePressed) {
+        profilerOverlayVisible = !profilerOverlayVisible;
+        profilerTogglePressed = true;
     }
-
-    // Draw vertical cars (larger)
-    for (auto& car : verticalCars) {
-        glColor3f(0.0f, 0.0f, 1.0f); // Blue color for vertical cars
-         glBegin(GL_QUADS); // Using QUADS for a slightly more complex shape
-            // Main body
-            glVertex2f(car.x + 0.02f, car.y); // Bottom-left of main body
-            glVertex2f(car.x + 0.08f, car.y); // Bottom-right of main body
-            glVertex2f(car.x + 0.08f, car.y - 0.15f); // Top-right of main body
-            glVertex2f(car.x + 0.02f, car.y - 0.15f); // Top-left of main body
-
-            // Front (hood)
-            glVertex2f(car.x + 0.03f, car.y - 0.15f);
-            glVertex2f(car.x + 0.07f, car.y - 0.15f);
-            glVertex2f(car.x + 0.07f, car.y - 0.18f);
-            glVertex2f(car.x + 0.03f, car.y - 0.18f);
-
-            // Back (trunk)
-            glVertex2f(car.x + 0.03f, car.y + 0.03f);
-            glVertex2f(car.x + 0.07f, car.y + 0.03f);
-            glVertex2f(car.x + 0.07f, car.y);
-            glVertex2f(car.x + 0.03f, car.y);
-        glEnd();
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE) {
+        profilerTogglePressed = false;
     }
 
-    // Draw textures to the right of signal lights (maintaining aspect ratio)
-    glEnable(GL_TEXTURE_2D);
-    glColor3f(1.0f, 1.0f, 1.0f); // Set color to white for textured quads
-
-    // Draw texture 1 right of horizontal light (0.3f, 0.1f) size 0.1x0.1
-    glBindTexture(GL_TEXTURE_2D, texture1Info.id);
-    float aspectRatio1 = (float)texture1Info.width / texture1Info.height;
-    float quadWidth1, quadHeight1;
-    float targetSize = 0.2f; // Target size for the larger dimension
-
-    if (texture1Info.width > texture1Info.height) {
-        quadWidth1 = targetSize;
-        quadHeight1 = targetSize / aspectRatio1;
-    } else {
-        quadHeight1 = targetSize;
-        quadWidth1 = targetSize * aspectRatio1;
+    // Print the frame and step time percentiles so far with the H key
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS && !histogramKeyPressed) {
+        printLatencies();
+        histogramKeyPressed = true;
     }
-
-    // Position centered vertically to the right of the horizontal light
-    float lightRight1 = 0.3f + 0.1f; // Right edge of horizontal light
-    float lightCenterY1 = 0.1f + 0.1f / 2.0f; // Vertical center of horizontal light
-    float quadBottomY1 = lightCenterY1 - quadHeight1 / 2.0f;
-
-    glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 1.0f); glVertex2f(lightRight1, quadBottomY1); // Bottom-left
-        glTexCoord2f(1.0f, 1.0f); glVertex2f(lightRight1 + quadWidth1, quadBottomY1); // Bottom-right
-        glTexCoord2f(1.0f, 0.0f); glVertex2f(lightRight1 + quadWidth1, quadBottomY1 + quadHeight1); // Top-right
-        glTexCoord2f(0.0f, 0.0f); glVertex2f(lightRight1, quadBottomY1 + quadHeight1); // Top-left
-    glEnd();
-
-    // Draw texture 2 right of vertical light (0.1f, 0.3f) size 0.1x0.1
-    glBindTexture(GL_TEXTURE_2D, texture2Info.id);
-    float aspectRatio2 = (float)texture2Info.width / texture2Info.height;
-    float quadWidth2, quadHeight2;
-
-    if (texture2Info.width > texture2Info.height) {
-        quadWidth2 = targetSize;
-        quadHeight2 = targetSize / aspectRatio2;
-    } else {
-        quadHeight2 = targetSize;
-        quadWidth2 = targetSize * aspectRatio2;
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_RELEASE) {
+        histogramKeyPressed = false;
     }
 
-     // Position centered vertically to the right of the vertical light
-    float lightRight2 = 0.1f + 0.1f; // Right edge of vertical light
-    float lightCenterY2 = 0.3f + 0.1f / 2.0f; // Vertical center of vertical light
-    float quadBottomY2 = lightCenterY2 - quadHeight2 / 2.0f;
-
-    glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 1.0f); glVertex2f(lightRight2, quadBottomY2); // Bottom-left
-        glTexCoord2f(1.0f, 1.0f); glVertex2f(lightRight2 + quadWidth2, quadBottomY2); // Bottom-right
-        glTexCoord2f(1.0f, 0.0f); glVertex2f(lightRight2 + quadWidth2, quadBottomY2 + quadHeight2); // Top-right
-        glTexCoord2f(0.0f, 0.0f); glVertex2f(lightRight2, quadBottomY2 + quadHeight2); // Top-left
-    glEnd();
-
-    glDisable(GL_TEXTURE_2D);
+    // Speed changes are multiplicative so both 0.1x and 50x are reachable in a few seconds
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS && simulationSpeed < 100.0f)
+        simulationSpeed = simulationSpeed * 1.02f;
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && simulationSpeed > 0.01f)
+        simulationSpeed = simulationSpeed / 1.02f;
 }
 
-void updateCars() {
-    // Update horizontal cars
-    for (size_t i = 0; i < horizontalCars.size(); ++i) {
-        Car& car = horizontalCars[i]; // Use reference for easier access
-        bool obstacleAhead = false;
-        float obstacleDistance = -1.0f; // Initialize with a value indicating no obstacle
-
-        // Check for collision with the car ahead
-        if (i > 0) {
-            // Distance between the front of the current car and the back of the car ahead
-            // Current horizontal car front is approximately car.x + 0.18f.
-            // Horizontal car ahead back is approximately horizontalCars[i-1].x - 0.03f.
-            obstacleDistance = (horizontalCars[i-1].x - 0.03f) - (car.x + 0.18f);
-            if (obstacleDistance <= DESIRED_CAR_GAP) {
-                 obstacleAhead = true;
-            }
-        }
-
-        // Check for traffic light if no immediate obstacle ahead
-        if (!horizontalGreen && !obstacleAhead) {
-            // Distance from the front of the car to the stop line (x = -0.1)
-            // Stop if the front of the car is at or past the stop line minus the desired gap
-            // Horizontal car front is approx car.x + 0.18f
-            float stopLineDistance = (-0.1f - DESIRED_CAR_GAP) - (car.x + 0.18f);
-            if (stopLineDistance <= 0.0f) {
-                 obstacleAhead = true; // Treat stop line as an obstacle if at or past it
-            } else if (obstacleDistance == -1.0f || stopLineDistance < obstacleDistance) {
-                // If no car ahead, or stop line is closer, consider stop line distance
-                 obstacleDistance = stopLineDistance;
-                 // obstacleAhead is true if stopLineDistance <= BRAKING_DISTANCE_BUFFER (handled below)
-            }
-        }
+// Step the simulation in real time, scaled by simulationSpeed, until
+// simulationRunning is cleared. A snapshot is published after every batch of steps.
+void simulationLoop() {
+    setTraceThreadName("simulation");
+    double previousTime = glfwGetTime();
+    double accumulator = 0.0; // Simulated time owed to the simulation
 
-        // Calculate required braking distance
-        // Using a simple formula: distance = speed^2 / (2 * deceleration)
-        float requiredBrakingDistance = (car.currentSpeed * car.currentSpeed) / (2.0f * DECELERATION);
+    while (simulationRunning.load()) {
+        int toggles = pendingSignalToggles.exchange(0);
+        for (int t = 0; t < toggles; ++t)
+            toggleSignals();
 
-        if (obstacleAhead && obstacleDistance <= requiredBrakingDistance + BRAKING_DISTANCE_BUFFER) {
-            // Decelerate if close to an obstacle or stop line
-            if (car.currentSpeed > 0.0f) {
-                 car.currentSpeed -= DECELERATION * simulationSpeed;
-                 if (car.currentSpeed < 0.0f) car.currentSpeed = 0.0f; // Cap at 0
-             }
+        // Run as many fixed steps as the elapsed (speed-scaled) time calls for
+        double currentTime = glfwGetTime();
+        float speed = simulationSpeed.load();
+        accumulator += (currentTime - previousTime) * speed;
+        previousTime = currentTime;
+
+        int substeps = 0;
+        auto stepStart = std::chrono::steady_clock::now();
+        while (accumulator >= SIM_DT && substeps < MAX_SUBSTEPS_PER_BATCH) {
+            timedStep(stepStart);
+            accumulator -= SIM_DT;
+            ++substeps;
+        }
+        if (substeps == MAX_SUBSTEPS_PER_BATCH)
+            accumulator = 0.0; // Can't keep up; slow down rather than spiral
+
+        if (substeps > 0 || toggles > 0) {
+            TraceZone zone("publishSnapshot");
+            SimulationSnapshot& snapshot = snapshots.writeBuffer();
+            captureSnapshot(snapshot);
+            snapshot.accumulator = accumulator;
+            snapshot.publishTime = currentTime;
+            snapshots.publish();
         } else {
-             // Accelerate if no obstacle or far enough away
-             if (car.currentSpeed < car.speed) {
-                 car.currentSpeed += ACCELERATION * simulationSpeed;
-                 if (car.currentSpeed > car.speed) car.currentSpeed = car.speed; // Cap at max speed
-             }
+            // Nothing due yet; sleep until the next step is, but wake often
+            // enough to pick up speed changes and signal toggles
+            double wait = std::min((SIM_DT - accumulator) / speed, 0.002);
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
         }
+    }
+}
 
-        // Update position based on current speed
-        car.x += car.currentSpeed * simulationSpeed;
+// How far the simulation has got from the snapshot's step towards the next one,
+// counting the time that passed since it was published. Drawing cars that far
+// between their last two positions keeps motion smooth at any frame rate.
+float interpolationAlpha(const SimulationSnapshot& snapshot) {
+    double owed = snapshot.accumulator + (glfwGetTime() - snapshot.publishTime) * simulationSpeed.load();
+    return (float)std::min(std::max(owed / SIM_DT, 0.0), 1.0);
+}
+
+// While recording, the render thread steps the simulation itself by exactly one
+// frame of (speed-scaled) time per frame, so the video plays back at an even
+// 60 fps however long each frame takes to draw and encode. Returns the
+// interpolation alpha for the captured state.
+float advanceRecording(SimulationSnapshot& snapshot) {
+    int toggles = pendingSignalToggles.exchange(0);
+    for (int t = 0; t < toggles; ++t)
+        toggleSignals();
+
+    recordingAccumulator += CAPTURE_FRAME_TIME * simulationSpeed.load();
+    int substeps = 0;
+    auto stepStart = std::chrono::steady_clock::now();
+    while (recordingAccumulator >= SIM_DT && substeps < MAX_SUBSTEPS_PER_BATCH) {
+        timedStep(stepStart);
+        recordingAccumulator -= SIM_DT;
+        ++substeps;
     }
+    if (substeps == MAX_SUBSTEPS_PER_BATCH)
+        recordingAccumulator = 0.0;
 
-    // Remove horizontal cars that are off-screen
-    horizontalCars.erase(
-        std::remove_if(horizontalCars.begin(), horizontalCars.end(),
-                       [](const Car& car) {
-                           return car.x > 1.2f; // Remove if moved far right
-                       }),
-        horizontalCars.end());
-
-    // Update vertical cars
-    for (size_t i = 0; i < verticalCars.size(); ++i) {
-        Car& car = verticalCars[i]; // Use reference for easier access
-        bool obstacleAhead = false;
-        float obstacleDistance = -1.0f; // Initialize with a value indicating no obstacle
-
-        // Check for collision with the car ahead
-        if (i > 0) {
-            // Distance between the front (bottom) of the current car and the back (top) of the car ahead
-            // Current vertical car front (bottom) is approximately car.y - 0.15f.
-            // Vertical car ahead back (top) is approximately verticalCars[i-1].y + 0.03f.
-            obstacleDistance = (car.y - 0.15f) - (verticalCars[i-1].y + 0.03f);
-             if (obstacleDistance <= DESIRED_CAR_GAP) {
-                 obstacleAhead = true;
-            }
-        }
+    captureSnapshot(snapshot);
+    return (float)std::min(recordingAccumulator / SIM_DT, 1.0);
+}
 
-        // Check for traffic light if no immediate obstacle ahead
-        if (!verticalGreen && !obstacleAhead) {
-            // Stop line for vertical cars moving down is at y = 0.1
-            // Distance from the front (bottom) of the car to the stop line (y = 0.1)
-            // Vertical car front (bottom) is approx car.y - 0.15f
-            float stopLineDistance = (car.y - 0.15f) - (0.1f + DESIRED_CAR_GAP);
-             if (stopLineDistance <= 0.0f) {
-                 obstacleAhead = true; // Treat stop line as an obstacle if at or past it
-            } else if (obstacleDistance == -1.0f || stopLineDistance < obstacleDistance) {
-                // If no car ahead, or stop line is closer, consider stop line distance
-                 obstacleDistance = stopLineDistance;
-                 // obstacleAhead is true if stopLineDistance <= BRAKING_DISTANCE_BUFFER (handled below)
-            }
-        }
+// Run the simulation in a tight loop with no window or GL context
+int runHeadless() {
+    // With --profile-csv each step is written as one row, the way a frame is
+    bool profiling = !profileCsvFile.empty();
+    if (profiling) {
+        if (!frameProfiler.openCsv(profileCsvFile))
+            return -1;
+        frameProfiler.setEnabled(true);
+    }
 
-        // Calculate required braking distance
-        // Using a simple formula: distance = speed^2 / (2 * deceleration)
-        float requiredBrakingDistance = (car.currentSpeed * car.currentSpeed) / (2.0f * DECELERATION);
+    auto start = std::chrono::steady_clock::now();
 
-        if (obstacleAhead && obstacleDistance <= requiredBrakingDistance + BRAKING_DISTANCE_BUFFER) {
-            // Decelerate if close to an obstacle or stop line
-             if (car.currentSpeed > 0.0f) {
-                 car.currentSpeed -= DECELERATION * simulationSpeed;
-                 if (car.currentSpeed < 0.0f) car.currentSpeed = 0.0f; // Cap at 0
-             }
-        } else {
-            // Accelerate if no obstacle or far enough away
-             if (car.currentSpeed < car.speed) {
-                 car.currentSpeed += ACCELERATION * simulationSpeed;
-                 if (car.currentSpeed > car.speed) car.currentSpeed = car.speed; // Cap at max speed
-            }
+    auto stepStart = start;
+    for (long long step = 0; step < headlessSteps; ++step) {
+        auto previousStart = stepStart;
+        timedStep(stepStart);
+        if (profiling) {
+            frameProfiler.endFrame(std::chrono::duration<double>(stepStart - previousStart).count());
+            stepStart = std::chrono::steady_clock::now(); // Keep the CSV write out of the next step
         }
-
-        // Update position based on current speed
-        car.y -= car.currentSpeed * simulationSpeed; // Negative because moving down
     }
 
-    // Remove vertical cars that are off-screen
-    verticalCars.erase(
-        std::remove_if(verticalCars.begin(), verticalCars.end(),
-                       [](const Car& car) {
-                           return car.y < -1.2f; // Remove if moved far down
-                       }),
-        verticalCars.end());
+    auto end = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(end - start).count();
+    double stepsPerSecond = elapsed > 0.0 ? headlessSteps / elapsed : 0.0;
+
+    std::cout << "Headless run: " << headlessSteps << " steps in " << elapsed << " s"
+              << " (" << carKernelName() << " car kernel, " << simulationThreads << " threads)" << std::endl;
+    std::cout << "Steps/second: " << stepsPerSecond
+              << " (" << stepsPerSecond * SIM_DT << "x real time)" << std::endl;
+    std::cout << "Cars remaining: " << totalCars() << " in " << lanes.size() << " lanes, "
+              << nodes.size() << " intersections (" << waitingCars() << " waiting to enter)" << std::endl;
+    std::cout << "Seed: " << simulationSeed << ", state checksum: " << std::hex << stateChecksum()
+              << std::dec << std::endl;
+    printLatencies();
+    printTrafficSummary();
+    if (!trafficCsvFile.empty() && !writeTrafficCsv(trafficCsvFile))
+        return -1;
+    return 0;
 }
 
-// Function to load a texture (will be implemented next)
-unsigned int loadTexture(const char* filename) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << filename << std::endl;
-        stbi_image_free(data);
+// Parse command line options. Returns false on an unknown or malformed option.
+bool parseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            headlessMode = true;
+        } else if (arg == "--scenario" && i + 1 < argc) {
+            scenarioName = argv[++i];
+        } else if (arg == "--grid-size" && i + 1 < argc) {
+            gridSize = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int threads = std::atoi(argv[++i]);
+            // 0 means one thread per hardware core
+            simulationThreads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seedSimulation(std::strtoull(argv[++i], nullptr, 10));
+        } else if (arg == "--arrival-rate" && i + 1 < argc) {
+            arrivalRateOption = std::atof(argv[++i]);
+        } else if (arg == "--scalar") {
+            setScalarCarKernel(true);
+        } else if (arg == "--no-buffer-storage") {
+            setBufferStorageEnabled(false);
+        } else if (arg == "--capture" && i + 1 < argc) {
+            captureDirectory = argv[++i];
+        } else if (arg == "--capture-video" && i + 1 < argc) {
+            captureVideoFile = argv[++i];
+        } else if (arg == "--capture-frames" && i + 1 < argc) {
+            captureFrameLimit = std::atoll(argv[++i]);
+        } else if (arg == "--profile-csv" && i + 1 < argc) {
+            profileCsvFile = argv[++i];
+        } else if (arg == "--kpi-csv" && i + 1 < argc) {
+            trafficCsvFile = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            traceFile = argv[++i];
+        } else if (arg == "--steps" && i + 1 < argc) {
+            headlessSteps = std::atoll(argv[++i]);
+            if (headlessSteps <= 0) {
+                std::cout << "--steps expects a positive number" << std::endl;
+                return false;
+            }
+        } else {
+            std::cout << "Unknown option: " << arg << std::endl;
+            std::cout << "Usage: " << argv[0] << " [--headless] [--steps N] [--scenario crossing|fourway|grid] [--grid-size N] [--threads N] [--seed N] [--arrival-rate R] [--scalar] [--no-buffer-storage] [--capture DIR | --capture-video FILE] [--capture-frames N] [--profile-csv FILE] [--trace FILE] [--kpi-csv FILE]" << std::endl;
+            return false;
+        }
     }
-
-    return textureID;
+    if (!captureDirectory.empty() && !captureVideoFile.empty()) {
+        std::cout << "--capture and --capture-video cannot be used together" << std::endl;
+        return false;
+    }
+    return true;
 }
 
-// Modified loadTexture to return TextureInfo
-TextureInfo loadTextureInfo(const char* filename) {
-    TextureInfo textureInfo = {0, 0, 0};
-    glGenTextures(1, &textureInfo.id);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureInfo.id);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        textureInfo.width = width;
-        textureInfo.height = height;
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << filename << std::endl;
-        stbi_image_free(data);
+int main(int argc, char** argv) {
+    if (!parseArguments(argc, argv))
+        return -1;
+
+    if (!loadScenario(scenarioName, gridSize)) {
+        std::cout << "Unknown scenario: " << scenarioName << std::endl;
+        return -1;
+    }
+    setSimulationThreads(simulationThreads);
+    if (arrivalRateOption >= 0.0)
+        setArrivalRate(arrivalRateOption);
+
+    setTraceThreadName("main");
+    if (!traceFile.empty())
+        startTracing();
+
+    if (headlessMode) {
+        int result = runHeadless();
+        if (!traceFile.empty())
+            writeTrace(traceFile);
+        return result;
     }
 
-    return textureInfo;
-}
+    // Decode the images (or map the cached atlas) on worker threads while GLFW
+    // and the GL context start
+    spriteAtlas.beginLoad("pic", "build/atlas.cache", std::max(1u, std::thread::hardware_concurrency()));
 
-int main() {
     glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // Required on macOS
     GLFWwindow* window = glfwCreateWindow(800, 600, "Traffic Simulation", NULL, NULL);
     if (!window) {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -549,41 +338,105 @@ int main() {
         return -1;
     }
 
-    // Load textures
-    // unsigned int texture1 = loadTexture("pic/Traffic-1.png"); // Assuming .png extension, adjust if needed
-    // unsigned int texture2 = loadTexture("pic/Traffic-2.png"); // Assuming .png extension, adjust if needed
+    if (!initRenderer()) {
+        std::cout << "Failed to initialize renderer" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    // Textures finished decoding while the window came up; upload them now
+    spriteAtlas.finishLoad();
 
-    texture1Info = loadTextureInfo("pic/Traffic-1.png"); // Assuming .png extension, adjust if needed
-    texture2Info = loadTextureInfo("pic/Traffic-2.png"); // Assuming .png extension, adjust if needed
+    if (!profileCsvFile.empty() && !frameProfiler.openCsv(profileCsvFile)) {
+        glfwTerminate();
+        return -1;
+    }
 
+    int windowWidth, windowHeight;
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    if (!captureDirectory.empty() && !frameCapture.startImages(captureDirectory, windowWidth, windowHeight)) {
+        glfwTerminate();
+        return -1;
+    }
+    if (!captureVideoFile.empty() && !frameCapture.startVideo(captureVideoFile, windowWidth, windowHeight)) {
+        glfwTerminate();
+        return -1;
+    }
+
+    // The render thread starts from the initial state until the first steps are published
+    captureSnapshot(snapshots.writeBuffer());
+    snapshots.writeBuffer().publishTime = glfwGetTime();
+    snapshots.publish();
+    std::thread simulationThread;
+    if (!frameCapture.active()) {
+        simulationRunning = true;
+        simulationThread = std::thread(simulationLoop);
+    }
+    SimulationSnapshot recordedState;
+
+    frameProfiler.setEnabled(true);
+    auto frameStart = std::chrono::steady_clock::now();
     while (!glfwWindowShouldClose(window)) {
-        processInput(window);
-        updateCars();
+        {
+            ProfileScope scope(PHASE_INPUT);
+            processInput(window);
+        }
 
-        // Random car generation logic
-        double currentTime = glfwGetTime();
-        if (currentTime - lastSpawnTime >= spawnInterval) {
-            lastSpawnTime = currentTime;
-            if (spawnChanceDist(rng) < spawnProbability) {
-                int carType = carTypeDist(rng);
-                // Generate a random speed
-                float randomSpeed = carSpeedDist(rng);
-                if (carType == 0) { // Horizontal car
-                    // Initialize currentSpeed to 0.0f, assign random max speed
-                    horizontalCars.push_back({-0.95f, -0.05f, randomSpeed, 0});
-                } else { // Vertical car
-                    // Initialize currentSpeed to 0.0f, assign random max speed
-                    verticalCars.push_back({-0.05f, 0.95f, randomSpeed, 1});
-                }
+        // Step the recording before the render scope opens, so its update and
+        // spawn phases are not counted as render time too
+        float recordedAlpha = 0.0f;
+        if (frameCapture.active())
+            recordedAlpha = advanceRecording(recordedState);
+
+        {
+            ProfileScope scope(PHASE_RENDER);
+            if (frameCapture.active()) {
+                frameCapture.beginFrame();
+                renderScene(recordedState, recordedAlpha);
+                if (profilerOverlayVisible)
+                    renderProfilerOverlay();
+                glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+                frameCapture.endFrame(windowWidth, windowHeight);
+                if (captureFrameLimit > 0 && frameCapture.framesCaptured() >= captureFrameLimit)
+                    glfwSetWindowShouldClose(window, true);
+            } else {
+                // Draw the newest state; the simulation keeps stepping meanwhile
+                const SimulationSnapshot& snapshot = snapshots.acquire();
+                renderScene(snapshot, interpolationAlpha(snapshot));
+                if (profilerOverlayVisible)
+                    renderProfilerOverlay();
             }
         }
 
-        renderScene();
+        {
+            ProfileScope scope(PHASE_SWAP);
+            glfwSwapBuffers(window);
+        }
+        {
+            ProfileScope scope(PHASE_INPUT);
+            glfwPollEvents();
+        }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        auto frameEnd = std::chrono::steady_clock::now();
+        frameProfiler.endFrame(std::chrono::duration<double>(frameEnd - frameStart).count());
+        frameTimes.record(frameEnd - frameStart);
+        frameStart = frameEnd;
     }
 
+    if (simulationThread.joinable()) {
+        simulationRunning = false;
+        simulationThread.join();
+    }
+    frameCapture.finish();
+    frameProfiler.printSummary();
+    printLatencies();
+    printTrafficSummary();
+    if (!trafficCsvFile.empty())
+        writeTrafficCsv(trafficCsvFile);
+    if (!traceFile.empty())
+        writeTrace(traceFile);
+
+    shutdownRenderer();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+// A whole file mapped read-only into memory. The OS pages it in on first touch,
+// so opening even a large file is nearly free.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file is missing, empty or cannot be mapped
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
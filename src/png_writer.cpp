@@ -0,0 +1,206 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// Deflate's length and distance codes: the smallest value each code covers,
+// and how many extra bits follow it
+const int LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                             35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                              3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                               257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+const int WINDOW_SIZE = 32768;
+const int HASH_BITS = 15;
+
+// Deflate packs bits starting from the least significant one
+struct BitWriter {
+    std::vector<unsigned char>& out;
+    unsigned buffer = 0;
+    int count = 0;
+
+    explicit BitWriter(std::vector<unsigned char>& target) : out(target) {}
+
+    void write(unsigned bits, int length) {
+        buffer |= bits << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back((unsigned char)buffer);
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes are stored most significant bit first
+    void writeCode(unsigned code, int length) {
+        unsigned reversed = 0;
+        for (int i = 0; i < length; ++i)
+            reversed |= ((code >> i) & 1) << (length - 1 - i);
+        write(reversed, length);
+    }
+
+    void flush() {
+        if (count > 0)
+            out.push_back((unsigned char)buffer);
+        buffer = 0;
+        count = 0;
+    }
+};
+
+// Literal/length symbol in the fixed Huffman code of RFC 1951, section 3.2.6
+void writeSymbol(BitWriter& bits, int symbol) {
+    if (symbol < 144)
+        bits.writeCode(0x30 + symbol, 8);
+    else if (symbol < 256)
+        bits.writeCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        bits.writeCode(symbol - 256, 7);
+    else
+        bits.writeCode(0xC0 + symbol - 280, 8);
+}
+
+void writeMatch(BitWriter& bits, int length, int distance) {
+    int code = 28;
+    while (LENGTH_BASE[code] > length)
+        --code;
+    writeSymbol(bits, 257 + code);
+    bits.write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+    code = 29;
+    while (DISTANCE_BASE[code] > distance)
+        --code;
+    bits.writeCode(code, 5);
+    bits.write(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+unsigned hashAt(const unsigned char* data) {
+    unsigned value = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+unsigned adler32(const std::vector<unsigned char>& data) {
+    unsigned a = 1, b = 0;
+    for (unsigned char byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+std::vector<unsigned> makeCrcTable() {
+    std::vector<unsigned> table(256);
+    for (unsigned n = 0; n < 256; ++n) {
+        unsigned c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+unsigned crc32(const unsigned char* data, size_t size, unsigned crc = 0) {
+    static const std::vector<unsigned> table = makeCrcTable();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// zlib stream holding one fixed-Huffman deflate block. Matches are found
+// through a table of the last position each 3-byte prefix was seen at.
+std::vector<unsigned char> compress(const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> out = {0x78, 0x01};
+    BitWriter bits(out);
+    bits.write(1, 1); // Final block
+    bits.write(1, 2); // Fixed Huffman codes
+
+    std::vector<int> lastSeen((size_t)1 << HASH_BITS, -1);
+    size_t size = data.size();
+    size_t i = 0;
+    while (i < size) {
+        int length = 0;
+        int distance = 0;
+        if (i + MIN_MATCH <= size) {
+            unsigned hash = hashAt(&data[i]);
+            int candidate = lastSeen[hash];
+            lastSeen[hash] = (int)i;
+            if (candidate >= 0 && i - candidate <= WINDOW_SIZE) {
+                size_t limit = std::min((size_t)MAX_MATCH, size - i);
+                size_t matched = 0;
+                while (matched < limit && data[candidate + matched] == data[i + matched])
+                    ++matched;
+                if (matched >= MIN_MATCH) {
+                    length = (int)matched;
+                    distance = (int)(i - candidate);
+                }
+            }
+        }
+
+        if (length == 0) {
+            writeSymbol(bits, data[i]);
+            ++i;
+            continue;
+        }
+        writeMatch(bits, length, distance);
+        for (size_t k = i + 1; k < i + length && k + MIN_MATCH <= size; ++k)
+            lastSeen[hashAt(&data[k])] = (int)k;
+        i += length;
+    }
+    writeSymbol(bits, 256); // End of block
+    bits.flush();
+
+    unsigned checksum = adler32(data);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((unsigned char)(checksum >> shift));
+    return out;
+}
+
+void appendBigEndian(std::vector<unsigned char>& out, unsigned value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((unsigned char)(value >> shift));
+}
+
+void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+    appendBigEndian(out, (unsigned)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    appendBigEndian(out, crc32(&out[start], out.size() - start));
+}
+
+} // namespace
+
+bool writePng(const std::string& path, const unsigned char* rgba, int width, int height) {
+    // Every scanline starts with its filter type; 0 leaves it unfiltered
+    std::vector<unsigned char> scanlines;
+    scanlines.reserve((size_t)(width * 3 + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        scanlines.push_back(0);
+        const unsigned char* row = rgba + (size_t)y * width * 4;
+        for (int x = 0; x < width; ++x)
+            scanlines.insert(scanlines.end(), row + x * 4, row + x * 4 + 3);
+    }
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bits per channel, RGB, no interlacing
+
+    std::vector<unsigned char> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    appendChunk(file, "IHDR", header);
+    appendChunk(file, "IDAT", compress(scanlines));
+    appendChunk(file, "IEND", {});
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)file.data(), file.size());
+    return (bool)out;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Save 8-bit RGBA pixels, rows top to bottom, as an RGB PNG (alpha is dropped).
+// The image data is compressed with a small LZ77 + fixed Huffman deflate, which
+// is plenty for the flat colours the renderer draws. Returns false if the file
+// cannot be written.
+bool writePng(const std::string& path, const unsigned char* rgba, int width, int height);
@@ -0,0 +1,505 @@
+#include "renderer.h"
+
+#include <glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "frame_profiler.h"
+#include "simulation.h"
+#include "stream_buffer.h"
+#include "trace.h"
+
+TextureAtlas spriteAtlas;
+
+static unsigned int colorProgram;
+static unsigned int textureProgram;
+static VertexBatch sceneryBatch; // Never changes, so it is only uploaded once
+static bool sceneryValid = false;
+static VertexBatch sceneBatch;
+static unsigned int carProgram;
+static unsigned int carVao;
+static unsigned int carMeshVbo;
+static StreamBuffer carInstances;
+static int carMeshVertexCount;
+static SpriteBatch spriteBatch;
+static VertexBatch overlayBatch;
+
+void VertexBatch::create(bool isStatic) {
+    staticStorage = isStatic;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
+
+void VertexBatch::destroy() {
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    vbo = vao = 0;
+}
+
+void VertexBatch::clear() {
+    vertices.clear();
+    runs.clear();
+    changed = true;
+}
+
+void VertexBatch::setColor(float r, float g, float b) {
+    colorR = r;
+    colorG = g;
+    colorB = b;
+}
+
+void VertexBatch::addVertex(unsigned int mode, float x, float y) {
+    if (runs.empty() || runs.back().mode != mode)
+        runs.push_back({mode, (int)vertices.size(), 0});
+    vertices.push_back({x, y, colorR, colorG, colorB});
+    ++runs.back().count;
+    changed = true;
+}
+
+void VertexBatch::addTriangle(float x0, float y0, float x1, float y1, float x2, float y2) {
+    addVertex(GL_TRIANGLES, x0, y0);
+    addVertex(GL_TRIANGLES, x1, y1);
+    addVertex(GL_TRIANGLES, x2, y2);
+}
+
+void VertexBatch::addQuad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3) {
+    addTriangle(x0, y0, x1, y1, x2, y2);
+    addTriangle(x0, y0, x2, y2, x3, y3);
+}
+
+void VertexBatch::addRectangle(float x, float y, float width, float height) {
+    addQuad(x, y, x + width, y, x + width, y + height, x, y + height);
+}
+
+void VertexBatch::addLine(float x0, float y0, float x1, float y1) {
+    addVertex(GL_LINES, x0, y0);
+    addVertex(GL_LINES, x1, y1);
+}
+
+void VertexBatch::draw() {
+    if (vertices.empty())
+        return;
+
+    if (changed) {
+        // Re-specifying the whole store lets the driver hand out fresh memory
+        // instead of waiting for the GPU to finish with last frame's vertices
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ColorVertex), vertices.data(),
+                     staticStorage ? GL_STATIC_DRAW : GL_STREAM_DRAW);
+        changed = false;
+    }
+
+    glBindVertexArray(vao);
+    for (const Run& run : runs)
+        glDrawArrays(run.mode, run.first, run.count);
+    glBindVertexArray(0);
+}
+
+void SpriteBatch::create() {
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
+
+void SpriteBatch::destroy() {
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    vbo = vao = 0;
+}
+
+void SpriteBatch::clear() {
+    vertices.clear();
+}
+
+void SpriteBatch::addSprite(const AtlasImage& image, float x, float y, float width, float height) {
+    float right = x + width;
+    float top = y + height;
+    // Image rows are stored top first, so v0 is the top edge
+    vertices.push_back({x, y, image.u0, image.v1});
+    vertices.push_back({right, y, image.u1, image.v1});
+    vertices.push_back({right, top, image.u1, image.v0});
+    vertices.push_back({x, y, image.u0, image.v1});
+    vertices.push_back({right, top, image.u1, image.v0});
+    vertices.push_back({x, top, image.u0, image.v0});
+}
+
+void SpriteBatch::draw(unsigned int texture) {
+    if (vertices.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(TexturedVertex), vertices.data(), GL_STREAM_DRAW);
+
+    glBindVertexArray(vao);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+    glBindVertexArray(0);
+}
+
+static bool readFile(const char* path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+static unsigned int compileShader(GLenum type, const char* path) {
+    std::string source;
+    if (!readFile(path, source)) {
+        std::cout << "Failed to read shader: " << path << std::endl;
+        return 0;
+    }
+
+    unsigned int shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, NULL);
+    glCompileShader(shader);
+
+    int success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cout << "Failed to compile shader " << path << ":\n" << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+unsigned int loadShaderProgram(const char* vertexPath, const char* fragmentPath) {
+    unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexPath);
+    unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentPath);
+    if (!vertexShader || !fragmentShader) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cout << "Failed to link shaders " << vertexPath << " + " << fragmentPath << ":\n" << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Build the one car mesh every car is drawn from. Coordinates are along the lane
+// (x) and across it (y, to the left of travel), relative to the car's position.
+static void createCarMesh() {
+    const float parts[3][4] = {
+        {0.0f, 0.15f, -0.03f, 0.03f}, // Main body
+        {0.15f, CAR_FRONT_OFFSET, -0.02f, 0.02f}, // Front (hood)
+        {-CAR_BACK_OFFSET, 0.0f, -0.02f, 0.02f}, // Back (trunk)
+    };
+    std::vector<float> mesh;
+    for (const auto& part : parts) {
+        float a0 = part[0], a1 = part[1], c0 = part[2], c1 = part[3];
+        float quad[] = {a0, c0, a1, c0, a1, c1, a0, c0, a1, c1, a0, c1};
+        mesh.insert(mesh.end(), quad, quad + 12);
+    }
+    carMeshVertexCount = (int)mesh.size() / 2;
+
+    glGenVertexArrays(1, &carVao);
+    glGenBuffers(1, &carMeshVbo);
+    carInstances.create(1024 * sizeof(CarInstance));
+    glBindVertexArray(carVao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, carMeshVbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(float), mesh.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Attributes 1-3 advance once per car instead of once per vertex. They are
+    // pointed at this frame's region of the instance buffer in drawCars().
+    for (unsigned int attribute = 1; attribute <= 3; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glBindVertexArray(0);
+}
+
+bool initRenderer() {
+    colorProgram = loadShaderProgram("shaders/vertex.glsl", "shaders/fragment.glsl");
+    textureProgram = loadShaderProgram("shaders/texture_vertex.glsl", "shaders/texture_fragment.glsl");
+    carProgram = loadShaderProgram("shaders/car_vertex.glsl", "shaders/fragment.glsl");
+    if (!colorProgram || !textureProgram || !carProgram)
+        return false;
+
+    // Nothing is offset or tinted for now
+    glUseProgram(colorProgram);
+    glUniform2f(glGetUniformLocation(colorProgram, "offset"), 0.0f, 0.0f);
+    glUniform3f(glGetUniformLocation(colorProgram, "ourColor"), 1.0f, 1.0f, 1.0f);
+    glUseProgram(carProgram);
+    glUniform2f(glGetUniformLocation(carProgram, "offset"), 0.0f, 0.0f);
+    glUniform3f(glGetUniformLocation(carProgram, "ourColor"), 1.0f, 1.0f, 1.0f);
+    glUseProgram(textureProgram);
+    glUniform2f(glGetUniformLocation(textureProgram, "offset"), 0.0f, 0.0f);
+    glUniform1i(glGetUniformLocation(textureProgram, "image"), 0);
+    glUseProgram(0);
+
+    sceneryBatch.create(true);
+    sceneryValid = false;
+    sceneBatch.create();
+    overlayBatch.create();
+    createCarMesh();
+
+    spriteBatch.create();
+    return true;
+}
+
+void shutdownRenderer() {
+    sceneryBatch.destroy();
+    sceneBatch.destroy();
+    overlayBatch.destroy();
+    spriteBatch.destroy();
+    spriteAtlas.destroy();
+    glDeleteProgram(colorProgram);
+    glDeleteProgram(textureProgram);
+    glDeleteProgram(carProgram);
+    glDeleteBuffers(1, &carMeshVbo);
+    carInstances.destroy();
+    glDeleteVertexArrays(1, &carVao);
+}
+
+// Grass, roads, lane lines, crosswalks, trees, lampposts and buildings
+static void addScenery(VertexBatch& batch) {
+    // Draw background (grass)
+    batch.setColor(0.2f, 0.5f, 0.1f); // Green color for grass
+    batch.addRectangle(-1.0f, -1.0f, 2.0f, 2.0f);
+
+    // Draw roads
+    batch.setColor(0.2f, 0.2f, 0.2f);
+    batch.addRectangle(-1.0f, -0.1f, 2.0f, 0.2f); // Horizontal
+    batch.addRectangle(-0.1f, -1.0f, 0.2f, 2.0f); // Vertical
+
+    // Draw lane lines
+    batch.setColor(1.0f, 1.0f, 1.0f); // White color for lane lines
+    batch.addLine(-1.0f, 0.0f, 1.0f, 0.0f); // Horizontal middle line
+    batch.addLine(0.0f, -1.0f, 0.0f, 1.0f); // Vertical middle line
+
+    // Draw crosswalks
+    batch.setColor(1.0f, 1.0f, 1.0f); // White color for crosswalks
+    // Top crosswalk
+    batch.addQuad(-0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.15f, -0.1f, 0.15f);
+    batch.addQuad(-0.1f, 0.2f, 0.1f, 0.2f, 0.1f, 0.25f, -0.1f, 0.25f);
+    // Bottom crosswalk
+    batch.addQuad(-0.1f, -0.1f, 0.1f, -0.1f, 0.1f, -0.15f, -0.1f, -0.15f);
+    batch.addQuad(-0.1f, -0.2f, 0.1f, -0.2f, 0.1f, -0.25f, -0.1f, -0.25f);
+    // Left crosswalk
+    batch.addQuad(-0.1f, -0.1f, -0.15f, -0.1f, -0.15f, 0.1f, -0.1f, 0.1f);
+    batch.addQuad(-0.2f, -0.1f, -0.25f, -0.1f, -0.25f, 0.1f, -0.2f, 0.1f);
+    // Right crosswalk
+    batch.addQuad(0.1f, -0.1f, 0.15f, -0.1f, 0.15f, 0.1f, 0.1f, 0.1f);
+    batch.addQuad(0.2f, -0.1f, 0.25f, -0.1f, 0.25f, 0.1f, 0.2f, 0.1f);
+
+    // Draw simple trees (refined shapes)
+    batch.setColor(0.5f, 0.35f, 0.05f); // Brown color for trunks
+    batch.addQuad(-0.7f, 0.4f, -0.75f, 0.4f, -0.75f, 0.55f, -0.7f, 0.55f);
+    batch.addQuad(0.6f, -0.5f, 0.55f, -0.5f, 0.55f, -0.35f, 0.6f, -0.35f);
+
+    batch.setColor(0.1f, 0.6f, 0.1f); // Green color for tree tops (using triangles for a more rounded look)
+    batch.addTriangle(-0.725f, 0.7f, -0.85f, 0.55f, -0.6f, 0.55f); // Top triangle
+    batch.addTriangle(-0.725f, 0.6f, -0.8f, 0.45f, -0.65f, 0.45f); // Middle triangle
+    batch.addTriangle(0.575f, -0.2f, 0.45f, -0.35f, 0.7f, -0.35f); // Top triangle
+    batch.addTriangle(0.575f, -0.3f, 0.5f, -0.45f, 0.65f, -0.45f); // Middle triangle
+
+    // Draw simple lampposts
+    batch.setColor(1.0f, 1.0f, 0.0f); // Yellow color for lamppost lights
+    batch.addQuad(-0.22f, 0.8f, -0.16f, 0.8f, -0.16f, 0.83f, -0.22f, 0.83f);
+    batch.addQuad(0.16f, -0.8f, 0.22f, -0.8f, 0.22f, -0.83f, 0.16f, -0.83f);
+
+    // Draw buildings
+    // Building 1 (Top-left)
+    batch.setColor(0.7f, 0.7f, 0.7f); // Wall color
+    batch.addQuad(-0.9f, 0.5f, -0.6f, 0.5f, -0.6f, 0.9f, -0.9f, 0.9f);
+    batch.setColor(0.4f, 0.4f, 0.5f); // Window color
+    batch.addQuad(-0.85f, 0.55f, -0.8f, 0.55f, -0.8f, 0.85f, -0.85f, 0.85f);
+    batch.addQuad(-0.75f, 0.55f, -0.7f, 0.55f, -0.7f, 0.85f, -0.75f, 0.85f);
+
+    // Building 2 (Bottom-right)
+    batch.setColor(0.8f, 0.5f, 0.5f); // Wall color
+    batch.addQuad(0.6f, -0.9f, 0.9f, -0.9f, 0.9f, -0.5f, 0.6f, -0.5f);
+    batch.setColor(0.4f, 0.5f, 0.4f); // Window color
+    batch.addQuad(0.65f, -0.85f, 0.7f, -0.85f, 0.7f, -0.55f, 0.65f, -0.55f);
+    batch.addQuad(0.75f, -0.85f, 0.8f, -0.85f, 0.8f, -0.55f, 0.75f, -0.55f);
+    batch.addQuad(0.85f, -0.85f, 0.9f, -0.85f, 0.9f, -0.55f, 0.85f, -0.55f);
+
+    // Building 3 (Bottom-left, smaller)
+    batch.setColor(0.5f, 0.5f, 0.8f); // Wall color
+    batch.addQuad(-0.95f, -0.95f, -0.8f, -0.95f, -0.8f, -0.7f, -0.95f, -0.7f);
+    batch.setColor(0.3f, 0.3f, 0.4f); // Window color
+    batch.addQuad(-0.9f, -0.9f, -0.85f, -0.9f, -0.85f, -0.75f, -0.9f, -0.75f);
+
+    // Building 4 (Top-right, taller)
+    batch.setColor(0.5f, 0.8f, 0.5f); // Wall color
+    batch.addQuad(0.7f, 0.6f, 0.95f, 0.6f, 0.95f, 0.95f, 0.7f, 0.95f);
+    batch.setColor(0.4f, 0.6f, 0.4f); // Window color
+    batch.addQuad(0.75f, 0.65f, 0.8f, 0.65f, 0.8f, 0.9f, 0.75f, 0.9f);
+    batch.addQuad(0.85f, 0.65f, 0.9f, 0.65f, 0.9f, 0.9f, 0.85f, 0.9f);
+}
+
+static void addTrafficLights(VertexBatch& batch, const std::vector<Signal>& signals) {
+    // Draw traffic lights (larger)
+    bool horizontalGreen = signals[0].green;
+    bool verticalGreen = signals[1].green;
+    batch.setColor(horizontalGreen ? 0.0f : 1.0f, horizontalGreen ? 1.0f : 0.0f, 0.0f);
+    batch.addRectangle(0.3f, 0.1f, 0.1f, 0.1f); // Horizontal light
+    batch.setColor(verticalGreen ? 0.0f : 1.0f, verticalGreen ? 1.0f : 0.0f, 0.0f);
+    batch.addRectangle(0.1f, 0.3f, 0.1f, 0.1f); // Vertical light
+}
+
+static void drawCars(const std::vector<CarSnapshot>& cars, float alpha) {
+    if (cars.empty())
+        return;
+
+    // Draw cars (larger), oriented along their lane. The instances are written
+    // straight into the buffer the GPU reads when it is persistently mapped.
+    CarInstance* instance = (CarInstance*)carInstances.beginWrite(cars.size() * sizeof(CarInstance));
+    for (const CarSnapshot& car : cars) {
+        const Lane& lane = lanes[car.lane];
+        float x = car.previousX + (car.x - car.previousX) * alpha;
+        float y = car.previousY + (car.y - car.previousY) * alpha;
+        *instance++ = {x, y, lane.directionX, lane.directionY, lane.colorR, lane.colorG, lane.colorB};
+    }
+    size_t base = carInstances.endWrite();
+
+    glUseProgram(carProgram);
+    glBindVertexArray(carVao);
+    glBindBuffer(GL_ARRAY_BUFFER, carInstances.buffer());
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(CarInstance), (void*)(base + offsetof(CarInstance, x)));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(CarInstance), (void*)(base + offsetof(CarInstance, directionX)));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(CarInstance), (void*)(base + offsetof(CarInstance, r)));
+    glDrawArraysInstanced(GL_TRIANGLES, 0, carMeshVertexCount, (GLsizei)cars.size());
+    glBindVertexArray(0);
+    carInstances.fence();
+}
+
+// Add a sprite whose larger side is `targetSize`, keeping the image's aspect
+// ratio, with its left edge at `left` and centered vertically on `centerY`
+static void addImageSprite(SpriteBatch& batch, const char* name, float left, float centerY, float targetSize) {
+    const AtlasImage* image = spriteAtlas.find(name);
+    if (!image)
+        return;
+    float aspectRatio = (float)image->width / image->height;
+    float quadWidth, quadHeight;
+    if (image->width > image->height) {
+        quadWidth = targetSize;
+        quadHeight = targetSize / aspectRatio;
+    } else {
+        quadHeight = targetSize;
+        quadWidth = targetSize * aspectRatio;
+    }
+    batch.addSprite(*image, left, centerY - quadHeight / 2.0f, quadWidth, quadHeight);
+}
+
+static void drawSprites() {
+    spriteBatch.clear();
+
+    // Draw textures to the right of signal lights (maintaining aspect ratio)
+    float targetSize = 0.2f; // Target size for the larger dimension
+    // Texture 1 right of the horizontal light (0.3f, 0.1f) size 0.1x0.1
+    addImageSprite(spriteBatch, "Traffic-1", 0.3f + 0.1f, 0.1f + 0.1f / 2.0f, targetSize);
+    // Texture 2 right of the vertical light (0.1f, 0.3f) size 0.1x0.1
+    addImageSprite(spriteBatch, "Traffic-2", 0.1f + 0.1f, 0.3f + 0.1f / 2.0f, targetSize);
+
+    glUseProgram(textureProgram);
+    spriteBatch.draw(spriteAtlas.texture());
+}
+
+void renderScene(const SimulationSnapshot& snapshot, float alpha) {
+    // Clear screen
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (!sceneryValid) {
+        sceneryBatch.clear();
+        addScenery(sceneryBatch);
+        sceneryValid = true;
+    }
+    sceneBatch.clear();
+    addTrafficLights(sceneBatch, snapshot.signals);
+
+    glUseProgram(colorProgram);
+    sceneryBatch.draw();
+    sceneBatch.draw();
+
+    {
+        TraceZone zone("drawCars");
+        drawCars(snapshot.cars, alpha);
+    }
+
+    TraceZone zone("drawSprites");
+    drawSprites();
+}
+
+
+void renderProfilerOverlay() {
+    // One row per phase and one for the whole frame, top to bottom. A full bar is
+    // two 60 Hz frames; the grey tick marks one. The black tick inside each bar
+    // is the fastest time seen (min) and the red one the p99.
+    const float colors[PHASE_COUNT + 1][3] = {
+        {0.3f, 0.5f, 1.0f}, // input
+        {1.0f, 0.6f, 0.1f}, // update cars
+        {0.8f, 0.3f, 0.9f}, // spawn
+        {0.2f, 0.9f, 0.9f}, // render
+        {0.6f, 0.6f, 0.6f}, // swap
+        {1.0f, 1.0f, 1.0f}, // whole frame
+    };
+    const float left = -0.98f, top = 0.97f, width = 0.6f, rowHeight = 0.035f, gap = 0.015f;
+    const float fullScaleMs = 2000.0f / 60.0f;
+
+    overlayBatch.clear();
+    for (int row = 0; row <= PHASE_COUNT; ++row) {
+        PhaseStats stats = row < PHASE_COUNT ? frameProfiler.stats((ProfilePhase)row) : frameProfiler.frameStats();
+        float y = top - (row + 1) * (rowHeight + gap);
+        float minimum = std::min((float)stats.min / fullScaleMs, 1.0f) * width;
+        float average = std::min((float)stats.average / fullScaleMs, 1.0f) * width;
+        float p99 = std::min((float)stats.p99 / fullScaleMs, 1.0f) * width;
+
+        overlayBatch.setColor(0.1f, 0.1f, 0.1f);
+        overlayBatch.addRectangle(left, y, width, rowHeight);
+        overlayBatch.setColor(colors[row][0], colors[row][1], colors[row][2]);
+        overlayBatch.addRectangle(left, y, average, rowHeight);
+        overlayBatch.setColor(0.0f, 0.0f, 0.0f); // min
+        overlayBatch.addRectangle(left + minimum, y, 0.004f, rowHeight);
+        overlayBatch.setColor(1.0f, 0.1f, 0.1f); // p99
+        overlayBatch.addRectangle(left + p99 - 0.004f, y, 0.004f, rowHeight);
+        overlayBatch.setColor(0.5f, 0.5f, 0.5f);
+        overlayBatch.addRectangle(left + width / 2.0f, y, 0.002f, rowHeight);
+    }
+
+    glUseProgram(colorProgram);
+    overlayBatch.draw();
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+
+#include "simulation.h"
+#include "texture_atlas.h"
+
+// Every image in pic/, packed into one texture
+extern TextureAtlas spriteAtlas;
+
+// Compile and link a shader program from two GLSL files. Returns 0 on failure.
+unsigned int loadShaderProgram(const char* vertexPath, const char* fragmentPath);
+
+// A position + color vertex for the flat-colored shader (shaders/vertex.glsl)
+struct ColorVertex {
+    float x, y;
+    float r, g, b;
+};
+
+// Per-instance data for one car (shaders/car_vertex.glsl): where it is, which way
+// its lane points, and its color
+struct CarInstance {
+    float x, y;
+    float directionX, directionY;
+    float r, g, b;
+};
+
+// Collects flat-colored triangles and lines on the CPU and draws them from one
+// vertex buffer, with one draw call per run of same-type primitives so the
+// drawing order is kept. Like glColor3f, the color set with setColor() applies
+// to everything added after it.
+class VertexBatch {
+public:
+    // A static batch is expected to be filled once and drawn many times
+    void create(bool isStatic = false);
+    void destroy();
+    void clear();
+
+    void setColor(float r, float g, float b);
+    void addTriangle(float x0, float y0, float x1, float y1, float x2, float y2);
+    // Corners in order around the quad
+    void addQuad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3);
+    void addRectangle(float x, float y, float width, float height);
+    void addLine(float x0, float y0, float x1, float y1);
+
+    // Draw with the currently bound program, uploading the vertices first only
+    // if they changed since the last draw
+    void draw();
+
+private:
+    // Consecutive vertices drawn with one primitive type
+    struct Run {
+        unsigned int mode;
+        int first;
+        int count;
+    };
+
+    void addVertex(unsigned int mode, float x, float y);
+
+    float colorR = 1.0f, colorG = 1.0f, colorB = 1.0f;
+    std::vector<ColorVertex> vertices;
+    std::vector<Run> runs;
+    bool staticStorage = false;
+    bool changed = false;
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+};
+
+// A position + texture coordinate vertex for shaders/texture_vertex.glsl
+struct TexturedVertex {
+    float x, y;
+    float u, v;
+};
+
+// Collects textured quads that all sample the same texture (normally the sprite
+// atlas) and draws them with one bind and one draw call
+class SpriteBatch {
+public:
+    void create();
+    void destroy();
+    void clear();
+
+    // Draw `image` stretched over the given rectangle
+    void addSprite(const AtlasImage& image, float x, float y, float width, float height);
+
+    // Upload and draw with the currently bound program
+    void draw(unsigned int texture);
+
+private:
+    std::vector<TexturedVertex> vertices;
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+};
+
+// Load the shaders and create the GL buffers. Needs a current 3.3 core context.
+bool initRenderer();
+void shutdownRenderer();
+
+// Draw one frame. Only reads the snapshot and the fixed lane geometry, so the
+// simulation can keep stepping on another thread meanwhile. Cars are drawn
+// `alpha` of the way from their previous-step position to their current one.
+void renderScene(const SimulationSnapshot& snapshot, float alpha = 1.0f);
+// Bars showing the rolling average (and p99 tick) of each frameProfiler phase
+void renderProfilerOverlay();
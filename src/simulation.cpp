@@ -0,0 +1,468 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <memory>
+
+#include "frame_profiler.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+std::vector<Node> nodes;
+std::vector<Lane> lanes;
+std::vector<Signal> signals;
+std::vector<int> entryLanes;
+
+double simulationTime = 0.0;
+long long simulationSteps = 0;
+
+// Lane updates are spread over this pool when more than one thread is requested
+static std::unique_ptr<ThreadPool> simulationPool;
+const size_t LANES_PER_TASK = 32;
+
+// Variables for random car generation
+// Seeded from the clock unless seedSimulation() is called; the seed is kept so
+// a run can be repeated
+unsigned long long simulationSeed = std::chrono::steady_clock::now().time_since_epoch().count();
+double arrivalRate = 0.7; // Cars per second arriving at each entry lane
+// Add distribution for random speed
+std::uniform_real_distribution<float> carSpeedDist(0.003f, 0.009f); // Range for car speeds
+
+// Poisson arrival process for one entry lane. Inter-arrival times are drawn
+// ahead of time, so the random stream is only touched when a car arrives.
+struct ArrivalGenerator {
+    int lane;
+    std::mt19937 rng; // Own stream, so one lane's arrivals don't shift another's
+    double nextArrivalTime;
+    int waitingCars; // Arrived, but the lane entry is still occupied
+};
+
+static std::vector<ArrivalGenerator> arrivalGenerators;
+// Pending arrivals ordered by time, then by generator index to keep ties deterministic
+typedef std::pair<double, int> ArrivalEvent;
+static std::priority_queue<ArrivalEvent, std::vector<ArrivalEvent>, std::greater<ArrivalEvent>> arrivalEvents;
+static std::vector<int> blockedGenerators; // Generators with waiting cars
+
+// Lanes are sized for a tightly packed queue along their length, plus slack for
+// cars that spawn or hand over onto a queue that has backed up to the entry
+static size_t laneCapacity(float length) {
+    float carSpacing = CAR_FRONT_OFFSET + CAR_BACK_OFFSET + DESIRED_CAR_GAP;
+    return std::max<size_t>(64, (size_t)(4.0f * length / carSpacing));
+}
+
+static int addNode(float x, float y, bool firstGreen, double cycleTime, double firstSwitchTime) {
+    Node node;
+    node.x = x;
+    node.y = y;
+    node.firstSignal = (int)signals.size();
+    node.cycleTime = cycleTime;
+    node.nextSwitchTime = firstSwitchTime;
+    signals.push_back({firstGreen}); // East-west
+    signals.push_back({!firstGreen}); // North-south
+    nodes.push_back(node);
+    return (int)nodes.size() - 1;
+}
+
+// Add a lane whose lane coordinate 0 is at (centerX, centerY) shifted `rightOffset`
+// to the right of the direction of travel (directionX, directionY).
+static int addLane(float centerX, float centerY, float directionX, float directionY, float rightOffset,
+                   float spawnPosition, float stopLine, float endPosition, int signal,
+                   float r, float g, float b) {
+    Lane lane;
+    lane.originX = centerX + directionY * rightOffset;
+    lane.originY = centerY - directionX * rightOffset;
+    lane.directionX = directionX;
+    lane.directionY = directionY;
+    lane.stopLine = stopLine;
+    lane.spawnPosition = spawnPosition;
+    lane.endPosition = endPosition;
+    lane.signal = signal;
+    lane.nextLane = -1;
+    lane.colorR = r;
+    lane.colorG = g;
+    lane.colorB = b;
+    lane.cars = CarQueue(laneCapacity(endPosition - spawnPosition));
+    lane.hasExitLeader = false;
+    lane.exitLeaderPosition = 0.0f;
+    lanes.push_back(lane);
+    return (int)lanes.size() - 1;
+}
+
+// Add a lane that drives through the single intersection at the origin and off screen
+static void addApproachLane(float directionX, float directionY, float rightOffset, int signal,
+                            float r, float g, float b) {
+    // Enters near the screen edge, stops at the edge of the crossing road,
+    // leaves well past the far edge of the screen
+    int lane = addLane(0.0f, 0.0f, directionX, directionY, rightOffset, -0.95f, -0.1f, 1.2f, signal, r, g, b);
+    entryLanes.push_back(lane);
+}
+
+// Add one straight road through a line of grid intersections. `nodeIds` lists
+// the intersections in the order cars meet them. The road is made of one link
+// per gap between intersections plus an entry and an exit link, each running
+// from one intersection center to the next.
+static void addGridRoad(const std::vector<int>& nodeIds, float directionX, float directionY,
+                        float spacing, int signalGroup, float r, float g, float b) {
+    int previousLane = -1;
+    for (size_t k = 0; k <= nodeIds.size(); ++k) {
+        // Links end at the center of the intersection they lead into; the exit
+        // link ends one spacing past the last intersection
+        const Node& last = nodes[nodeIds[std::min(k, nodeIds.size() - 1)]];
+        float endX = last.x, endY = last.y;
+        int signal = -1;
+        if (k < nodeIds.size())
+            signal = last.firstSignal + signalGroup;
+        else {
+            endX += directionX * spacing;
+            endY += directionY * spacing;
+        }
+
+        int lane = addLane(endX, endY, directionX, directionY, 0.05f, -spacing, -0.1f, 0.0f, signal, r, g, b);
+        if (previousLane < 0)
+            entryLanes.push_back(lane);
+        else
+            lanes[previousLane].nextLane = lane;
+        previousLane = lane;
+    }
+}
+
+static bool buildScenario(const std::string& name, int gridSize) {
+    nodes.clear();
+    lanes.clear();
+    signals.clear();
+    entryLanes.clear();
+
+    if (name == "crossing") {
+        // One lane per road, driving over the road's middle line
+        addNode(0.0f, 0.0f, true, 0.0, 0.0); // Switched by hand
+        addApproachLane(1.0f, 0.0f, 0.0f, 0, 1.0f, 0.0f, 0.0f); // Red cars moving right
+        addApproachLane(0.0f, -1.0f, 0.0f, 1, 0.0f, 0.0f, 1.0f); // Blue cars moving down
+        return true;
+    }
+    if (name == "fourway") {
+        // Two-way roads, one lane per direction, driving on the right
+        addNode(0.0f, 0.0f, true, 0.0, 0.0); // Switched by hand
+        addApproachLane(1.0f, 0.0f, 0.05f, 0, 1.0f, 0.0f, 0.0f);
+        addApproachLane(-1.0f, 0.0f, 0.05f, 0, 1.0f, 0.5f, 0.0f);
+        addApproachLane(0.0f, -1.0f, 0.05f, 1, 0.0f, 0.0f, 1.0f);
+        addApproachLane(0.0f, 1.0f, 0.05f, 1, 0.0f, 0.7f, 1.0f);
+        return true;
+    }
+    if (name == "grid" && gridSize > 0) {
+        // gridSize x gridSize intersections of two-way roads, each with its own
+        // fixed-time signal. Neighbouring signals are offset by a quarter cycle.
+        const float spacing = 2.0f;
+        const double cycleTime = 10.0;
+        float half = 0.5f * spacing * (gridSize - 1);
+        for (int row = 0; row < gridSize; ++row) {
+            for (int col = 0; col < gridSize; ++col) {
+                double offset = cycleTime * (1 + (row + col) % 4) / 4.0;
+                addNode(col * spacing - half, half - row * spacing, (row + col) % 2 == 0, cycleTime, offset);
+            }
+        }
+
+        std::vector<int> line(gridSize);
+        for (int row = 0; row < gridSize; ++row) {
+            for (int col = 0; col < gridSize; ++col)
+                line[col] = row * gridSize + col;
+            addGridRoad(line, 1.0f, 0.0f, spacing, 0, 1.0f, 0.0f, 0.0f); // Eastbound
+            std::reverse(line.begin(), line.end());
+            addGridRoad(line, -1.0f, 0.0f, spacing, 0, 1.0f, 0.5f, 0.0f); // Westbound
+        }
+        for (int col = 0; col < gridSize; ++col) {
+            for (int row = 0; row < gridSize; ++row)
+                line[row] = row * gridSize + col;
+            addGridRoad(line, 0.0f, -1.0f, spacing, 1, 0.0f, 0.0f, 1.0f); // Southbound
+            std::reverse(line.begin(), line.end());
+            addGridRoad(line, 0.0f, 1.0f, spacing, 1, 0.0f, 0.7f, 1.0f); // Northbound
+        }
+        return true;
+    }
+    return false;
+}
+
+static double drawInterArrivalTime(ArrivalGenerator& generator) {
+    if (arrivalRate <= 0.0)
+        return std::numeric_limits<double>::infinity();
+    std::exponential_distribution<double> gap(arrivalRate);
+    return gap(generator.rng);
+}
+
+// Restart every entry lane's arrival stream from the current seed and time
+static void resetArrivals() {
+    arrivalGenerators.clear();
+    arrivalEvents = decltype(arrivalEvents)();
+    blockedGenerators.clear();
+    for (size_t g = 0; g < entryLanes.size(); ++g) {
+        ArrivalGenerator generator;
+        generator.lane = entryLanes[g];
+        std::seed_seq seeds{(unsigned)simulationSeed, (unsigned)(simulationSeed >> 32), (unsigned)g};
+        generator.rng.seed(seeds);
+        generator.nextArrivalTime = simulationTime + drawInterArrivalTime(generator);
+        generator.waitingCars = 0;
+        arrivalGenerators.push_back(generator);
+        arrivalEvents.push({generator.nextArrivalTime, (int)g});
+    }
+}
+
+bool loadScenario(const std::string& name, int gridSize) {
+    bool loaded = buildScenario(name, gridSize);
+    resetArrivals();
+    return loaded;
+}
+
+static void switchNode(const Node& node) {
+    signals[node.firstSignal].green = !signals[node.firstSignal].green;
+    signals[node.firstSignal + 1].green = !signals[node.firstSignal + 1].green;
+}
+
+void toggleSignals() {
+    for (const Node& node : nodes)
+        switchNode(node);
+}
+
+// Switch every fixed-time signal whose cycle has come round
+static void updateSignals() {
+    for (Node& node : nodes) {
+        if (node.cycleTime > 0.0 && simulationTime >= node.nextSwitchTime) {
+            switchNode(node);
+            node.nextSwitchTime += node.cycleTime;
+        }
+    }
+}
+
+// Steps a car entering at `entrySpeed` needs to cover `distance` on a clear road,
+// speeding up at ACCELERATION until it reaches `maxSpeed`
+static float freeFlowSteps(float distance, float entrySpeed, float maxSpeed) {
+    float accelDistance = (maxSpeed * maxSpeed - entrySpeed * entrySpeed) / (2.0f * ACCELERATION);
+    if (distance >= accelDistance)
+        return (maxSpeed - entrySpeed) / ACCELERATION + (distance - accelDistance) / maxSpeed;
+    return (std::sqrt(entrySpeed * entrySpeed + 2.0f * ACCELERATION * distance) - entrySpeed) / ACCELERATION;
+}
+
+// Add this step to the lane's traffic measures, once its cars have moved
+static void measureApproach(Lane& lane) {
+    ApproachStats& stats = lane.stats;
+    const CarQueue& cars = lane.cars;
+    ++stats.steps;
+
+    // Cars that crossed the stop line this step, with their delay against free flow
+    size_t passed = stats.carsPastStopLine;
+    for (; passed < cars.size() && cars.position(passed) >= lane.stopLine; ++passed) {
+        float freeFlow = freeFlowSteps(lane.stopLine - lane.spawnPosition, cars.entrySpeed(passed), cars.maxSpeed(passed));
+        stats.delaySteps += (simulationSteps - cars.entryStep(passed)) - freeFlow;
+        ++stats.discharged;
+    }
+    stats.carsPastStopLine = passed;
+
+    // A queue starts with a slow car held at the stop line and continues through
+    // each slow car right behind the one ahead of it
+    int queue = 0;
+    float limit = lane.stopLine - DESIRED_CAR_GAP - QUEUE_GAP_TOLERANCE; // Furthest back the next front may be
+    for (size_t i = passed; i < cars.size() && cars.currentSpeed(i) < QUEUE_SPEED_FRACTION * cars.maxSpeed(i); ++i) {
+        if (cars.position(i) + CAR_FRONT_OFFSET < limit)
+            break;
+        limit = cars.position(i) - CAR_BACK_OFFSET - DESIRED_CAR_GAP - QUEUE_GAP_TOLERANCE;
+        ++queue;
+    }
+    stats.queuedCarSteps += queue;
+    stats.maxQueue = std::max(stats.maxQueue, queue);
+}
+
+void updateLane(Lane& lane) {
+    // Each fixed step moves cars by exactly one tuned step (time scale 1)
+    bool green = lane.signal < 0 || signals[lane.signal].green;
+    LaneParams params = {CAR_FRONT_OFFSET, CAR_BACK_OFFSET, lane.stopLine, green, 1.0f,
+                         lane.hasExitLeader, lane.exitLeaderPosition};
+
+    // The ring may wrap; the second run follows the last car of the first
+    CarQueue::Span spans[2];
+    int spanCount = lane.cars.spans(spans);
+    for (int s = 0; s < spanCount; ++s) {
+        float tailStart = spans[s].position[spans[s].count - 1];
+        updateLaneCars(spans[s].position, spans[s].currentSpeed, spans[s].maxSpeed,
+                       spans[s].count, params);
+        params.hasLeader = true;
+        params.leaderPosition = tailStart;
+    }
+
+    if (lane.signal >= 0)
+        measureApproach(lane);
+}
+
+// Move lead cars past the end of their lane onto the next lane or out of the simulation
+static void handOffCars(Lane& lane) {
+    while (!lane.cars.empty() && lane.cars.position(0) > lane.endPosition) {
+        if (lane.nextLane >= 0) {
+            Lane& next = lanes[lane.nextLane];
+            float entry = next.spawnPosition + (lane.cars.position(0) - lane.endPosition);
+            if (!next.cars.push_back(entry, lane.cars.maxSpeed(0), lane.cars.currentSpeed(0), simulationSteps))
+                break; // Next lane is full; try again next step
+        }
+        lane.cars.pop_front();
+        if (lane.stats.carsPastStopLine > 0)
+            --lane.stats.carsPastStopLine;
+    }
+}
+
+void updateCars() {
+    ++simulationSteps;
+    updateSignals();
+
+    // The lead car of each lane follows the last car on the lane it drives into,
+    // as it was before anything moved this step
+    for (Lane& lane : lanes) {
+        lane.hasExitLeader = false;
+        if (lane.nextLane >= 0) {
+            const Lane& next = lanes[lane.nextLane];
+            if (!next.cars.empty()) {
+                lane.hasExitLeader = true;
+                lane.exitLeaderPosition = next.cars.position(next.cars.size() - 1)
+                                        - next.spawnPosition + lane.endPosition;
+            }
+        }
+    }
+
+    // Lanes only read their own cars and exit leader, so they can run in parallel.
+    // The pool joins before the hand-offs, which move cars between lanes.
+    {
+        TraceZone zone("updateLanes");
+        if (simulationPool) {
+            simulationPool->parallelFor(lanes.size(), LANES_PER_TASK, [](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    updateLane(lanes[i]);
+            });
+        } else {
+            for (Lane& lane : lanes)
+                updateLane(lane);
+        }
+    }
+
+    TraceZone zone("handOffCars");
+    for (Lane& lane : lanes)
+        handOffCars(lane);
+}
+
+void setSimulationThreads(unsigned threadCount) {
+    if (threadCount > 1)
+        simulationPool.reset(new ThreadPool(threadCount));
+    else
+        simulationPool.reset();
+}
+
+// Whether a car placed at the lane entry would keep the desired gap to the last car
+static bool entryIsClear(const Lane& lane) {
+    if (lane.cars.empty())
+        return true;
+    float tailBack = lane.cars.position(lane.cars.size() - 1) - CAR_BACK_OFFSET;
+    return tailBack - (lane.spawnPosition + CAR_FRONT_OFFSET) >= DESIRED_CAR_GAP;
+}
+
+void spawnCars(double currentTime) {
+    // Collect every arrival due by now, however many that is
+    while (!arrivalEvents.empty() && arrivalEvents.top().first <= currentTime) {
+        int index = arrivalEvents.top().second;
+        arrivalEvents.pop();
+        ArrivalGenerator& generator = arrivalGenerators[index];
+        if (generator.waitingCars++ == 0)
+            blockedGenerators.push_back(index);
+        generator.nextArrivalTime += drawInterArrivalTime(generator);
+        arrivalEvents.push({generator.nextArrivalTime, index});
+    }
+
+    // Let one waiting car into each lane whose entry has room
+    for (size_t b = 0; b < blockedGenerators.size();) {
+        ArrivalGenerator& generator = arrivalGenerators[blockedGenerators[b]];
+        Lane& lane = lanes[generator.lane];
+        if (entryIsClear(lane) && !lane.cars.full()) {
+            // Starts at the lane entry from standstill with a random max speed
+            lane.cars.push_back(lane.spawnPosition, carSpeedDist(generator.rng), 0.0f, simulationSteps);
+            --generator.waitingCars;
+        }
+        if (generator.waitingCars == 0) {
+            blockedGenerators[b] = blockedGenerators.back();
+            blockedGenerators.pop_back();
+        } else {
+            ++b;
+        }
+    }
+}
+
+void stepSimulation() {
+    {
+        ProfileScope scope(PHASE_UPDATE_CARS);
+        updateCars();
+    }
+    simulationTime += SIM_DT;
+    ProfileScope scope(PHASE_SPAWN);
+    spawnCars(simulationTime);
+}
+
+void seedSimulation(unsigned long long seed) {
+    simulationSeed = seed;
+    carSpeedDist.reset();
+    resetArrivals();
+}
+
+void setArrivalRate(double carsPerSecond) {
+    arrivalRate = carsPerSecond;
+    resetArrivals();
+}
+
+size_t waitingCars() {
+    size_t count = 0;
+    for (const ArrivalGenerator& generator : arrivalGenerators)
+        count += generator.waitingCars;
+    return count;
+}
+
+unsigned long long stateChecksum() {
+    // FNV-1a over the bits of every car's position and speed, lane by lane
+    unsigned long long hash = 14695981039346656037ull;
+    auto mix = [&hash](float value) {
+        unsigned int bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int byte = 0; byte < 4; ++byte) {
+            hash ^= (bits >> (8 * byte)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    for (const Lane& lane : lanes) {
+        for (size_t i = 0; i < lane.cars.size(); ++i) {
+            mix(lane.cars.position(i));
+            mix(lane.cars.currentSpeed(i));
+        }
+    }
+    return hash;
+}
+
+size_t totalCars() {
+    size_t count = 0;
+    for (const Lane& lane : lanes)
+        count += lane.cars.size();
+    return count;
+}
+
+void captureSnapshot(SimulationSnapshot& snapshot) {
+    snapshot.cars.clear();
+    for (size_t l = 0; l < lanes.size(); ++l) {
+        const Lane& lane = lanes[l];
+        for (size_t i = 0; i < lane.cars.size(); ++i) {
+            // Each step moves a car by its current speed, so that is where it just was.
+            // Cars that changed lanes this step are on a straight continuation.
+            float position = lane.cars.position(i);
+            float previous = position - lane.cars.currentSpeed(i);
+            snapshot.cars.push_back({lane.originX + lane.directionX * position,
+                                     lane.originY + lane.directionY * position,
+                                     lane.originX + lane.directionX * previous,
+                                     lane.originY + lane.directionY * previous, (int)l});
+        }
+    }
+    snapshot.signals = signals;
+    snapshot.simulationTime = simulationTime;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "car_kernel.h"
+#include "car_queue.h"
+
+// Car shape along the direction of travel, measured from the car's position
+const float CAR_FRONT_OFFSET = 0.18f; // Front of the hood
+const float CAR_BACK_OFFSET = 0.03f; // Back of the trunk
+
+// A traffic signal; every lane bound to it stops on red
+struct Signal {
+    bool green;
+};
+
+// An intersection of the road network. Each node owns two signals, one for the
+// east-west approaches and one for the north-south approaches, and swaps them on
+// its own cycle.
+struct Node {
+    float x, y; // World position of the intersection center
+    int firstSignal; // East-west signal; the north-south one is firstSignal + 1
+    double cycleTime; // Seconds between automatic switches; 0 switches only on request
+    double nextSwitchTime;
+};
+
+// Traffic measures for one approach (a lane that ends at a signal), added to
+// incrementally as the lane is updated. Cars in a lane stay in order, so the
+// ones past the stop line are always its first few: each step only looks at
+// the cars that just crossed it and the queue behind it.
+struct ApproachStats {
+    long long steps = 0;
+    long long discharged = 0; // Cars that drove over the stop line
+    // Sum over discharged cars of the steps they took from entering the lane to
+    // the stop line, minus the steps the same distance takes on a clear road
+    // (speeding up from the car's entry speed to its free-flow speed)
+    double delaySteps = 0.0;
+    long long queuedCarSteps = 0; // Sum over steps of the queue length
+    int maxQueue = 0; // Most cars queued at once
+
+    size_t carsPastStopLine = 0; // Lead cars of the lane that have crossed the stop line
+};
+
+// The queue is the run of cars directly behind the stop line that are slower
+// than this fraction of their free-flow speed
+const float QUEUE_SPEED_FRACTION = 0.1f;
+// How much further than DESIRED_CAR_GAP a queued car may stand from the stop
+// line or from the car ahead. Cars brake to a stop within DESIRED_CAR_GAP, so
+// this only absorbs rounding.
+const float QUEUE_GAP_TOLERANCE = 0.01f;
+
+// One lane of one link of the road network. Cars live in a 1D lane coordinate that
+// grows in the direction of travel; the world position of a car is
+// origin + direction * position. Cars driving past endPosition continue onto
+// nextLane, entering it at its spawnPosition, or leave the simulation.
+struct Lane {
+    float originX, originY; // World position of lane coordinate 0 on the lane centerline
+    float directionX, directionY; // Unit vector of travel
+    float stopLine; // Lane coordinate of the stop line
+    float spawnPosition; // Lane coordinate where cars enter
+    float endPosition; // Lane coordinate where cars leave this lane
+    int signal; // Index into `signals`, or -1 for a lane that never stops
+    int nextLane; // Index into `lanes`, or -1 if cars leave the simulation
+    float colorR, colorG, colorB; // Car color when drawn
+
+    CarQueue cars; // Index 0 is the lead car; new cars join at the back
+
+    // Start-of-step position of the last car on nextLane, in this lane's coordinates.
+    // Set by updateCars() before any lane moves.
+    bool hasExitLeader;
+    float exitLeaderPosition;
+
+    ApproachStats stats; // Only kept for lanes with a signal
+};
+
+extern std::vector<Node> nodes;
+extern std::vector<Lane> lanes;
+extern std::vector<Signal> signals;
+extern std::vector<int> entryLanes; // Lanes that new cars can spawn into
+
+// Fixed simulation timestep. Car speeds and accelerations are tuned per step,
+// so every step covers the same simulated time no matter the frame rate.
+const double SIM_DT = 1.0 / 60.0;
+extern double simulationTime; // Simulated seconds since start
+extern long long simulationSteps; // Steps since start; the step being taken while cars move
+
+extern unsigned long long simulationSeed;
+
+// Restart the random car stream from `seed`. With the same seed, scenario and
+// number of steps a run reproduces exactly the same trajectory.
+void seedSimulation(unsigned long long seed);
+
+// Set the mean number of cars per second arriving at each entry lane
+void setArrivalRate(double carsPerSecond);
+
+// Cars that have arrived but are still waiting for room at a lane entry
+size_t waitingCars();
+
+// Hash of every car's position and speed, for checking that two runs match
+unsigned long long stateChecksum();
+
+// Build the network for a named scenario ("crossing", "fourway" or "grid").
+// `gridSize` is the number of intersections per side of the grid scenario.
+// Returns false if the name is unknown.
+bool loadScenario(const std::string& name, int gridSize = 10);
+
+// Swap every signal between red and green
+void toggleSignals();
+
+// Advance the cars of one lane by one step; they do not leave the lane yet.
+// Reads only this lane and its exit leader, so lanes can be updated in any order.
+void updateLane(Lane& lane);
+
+// Advance all lanes by one step, then move cars past the end of their lane
+// onto the next lane or out of the simulation
+void updateCars();
+
+// Update lanes on `threadCount` threads (including the caller); 1 runs inline
+void setSimulationThreads(unsigned threadCount);
+
+// Add every car that has arrived by `currentTime` (seconds). Each entry lane has
+// its own Poisson arrival stream; arrivals that find the entry occupied wait
+// and enter one at a time as room frees up.
+void spawnCars(double currentTime);
+
+// Advance the simulation by one fixed SIM_DT step
+void stepSimulation();
+
+// Total number of cars in all lanes
+size_t totalCars();
+
+// A car as the renderer sees it. Everything else it needs (direction, color)
+// comes from lanes[lane], whose geometry never changes once a scenario is loaded.
+struct CarSnapshot {
+    float x, y; // World position
+    float previousX, previousY; // World position one step earlier, for interpolation
+    int lane;
+};
+
+// Copy of everything drawn each frame, taken between two steps
+struct SimulationSnapshot {
+    std::vector<CarSnapshot> cars;
+    std::vector<Signal> signals;
+    double simulationTime;
+    // Filled in by whoever drives the steps: simulated time already owed to the
+    // next step, and the wall-clock time the snapshot was published at
+    double accumulator = 0.0;
+    double publishTime = 0.0;
+};
+
+// Fill `snapshot` with the current state, reusing its storage
+void captureSnapshot(SimulationSnapshot& snapshot);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+#include "simulation.h"
+
+// Passes the newest SimulationSnapshot from the simulation thread to the render
+// thread without locks. The writer fills its own slot and the reader draws from
+// its own slot; a finished snapshot is swapped in through a third, shared slot
+// with a single atomic exchange. Neither side ever waits for the other, and a
+// slot is never written while it is being drawn. Snapshots the reader never got
+// to are simply overwritten.
+class SnapshotExchange {
+public:
+    // The slot the simulation thread fills next
+    SimulationSnapshot& writeBuffer() { return slots[writeSlot]; }
+
+    // Make the filled write buffer the newest snapshot
+    void publish() {
+        writeSlot = shared.exchange(writeSlot | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // The newest published snapshot. It stays untouched by the writer until the
+    // next call to acquire().
+    const SimulationSnapshot& acquire() {
+        if (shared.load(std::memory_order_relaxed) & FRESH_BIT)
+            readSlot = shared.exchange(readSlot, std::memory_order_acq_rel) & INDEX_MASK;
+        return slots[readSlot];
+    }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4; // Set while the shared slot holds an unread snapshot
+
+    SimulationSnapshot slots[3];
+    int writeSlot = 0; // Only touched by the simulation thread
+    int readSlot = 1; // Only touched by the render thread
+    std::atomic<int> shared{2};
+};
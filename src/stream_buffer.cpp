@@ -0,0 +1,98 @@
+#include "stream_buffer.h"
+
+#include <glad.h>
+
+static bool bufferStorageEnabled = true;
+
+void setBufferStorageEnabled(bool enabled) {
+    bufferStorageEnabled = enabled;
+}
+
+void StreamBuffer::create(size_t regionBytes) {
+    glGenBuffers(1, &vbo);
+    allocate(regionBytes > 0 ? regionBytes : 1);
+}
+
+void StreamBuffer::destroy() {
+    release();
+    glDeleteBuffers(1, &vbo);
+    vbo = 0;
+}
+
+void StreamBuffer::allocate(size_t regionBytes) {
+    regionSize = regionBytes;
+    currentRegion = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    if (bufferStorageEnabled && glBufferStorage && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)) {
+        // Coherent, so writes are visible to the GPU without explicit flushes
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, regionSize * REGION_COUNT, NULL, flags);
+        mapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * REGION_COUNT, flags);
+        if (mapped)
+            return;
+        // Fall through with a fresh, mutable buffer
+        glDeleteBuffers(1, &vbo);
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    }
+
+    glBufferData(GL_ARRAY_BUFFER, regionSize * REGION_COUNT, NULL, GL_STREAM_DRAW);
+    staging.resize(regionSize);
+}
+
+// Drop the storage and fences (but keep the buffer name)
+void StreamBuffer::release() {
+    for (void*& sync : fences) {
+        if (sync)
+            glDeleteSync((GLsync)sync);
+        sync = nullptr;
+    }
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = nullptr;
+        // Storage made with glBufferStorage is immutable, so resizing needs a new buffer
+        glDeleteBuffers(1, &vbo);
+        glGenBuffers(1, &vbo);
+    }
+    staging.clear();
+}
+
+void* StreamBuffer::beginWrite(size_t bytes) {
+    currentRegion = (currentRegion + 1) % REGION_COUNT;
+
+    if (bytes > regionSize) {
+        // Orphaning is safe here: the GPU keeps the old storage alive until it is done
+        size_t grown = regionSize;
+        while (grown < bytes)
+            grown *= 2;
+        release();
+        allocate(grown);
+    }
+
+    GLsync sync = (GLsync)fences[currentRegion];
+    if (sync) {
+        // Normally signalled long ago; only blocks if the GPU is 3 frames behind
+        while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(sync);
+        fences[currentRegion] = nullptr;
+    }
+
+    writtenBytes = bytes;
+    return mapped ? mapped + currentRegion * regionSize : staging.data();
+}
+
+size_t StreamBuffer::endWrite() {
+    size_t offset = currentRegion * regionSize;
+    if (!mapped && writtenBytes > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, offset, writtenBytes, staging.data());
+    }
+    return offset;
+}
+
+void StreamBuffer::fence() {
+    fences[currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
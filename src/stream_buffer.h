@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Vertex buffer for data that is rewritten every frame, split into three regions
+// used round-robin. Each region is fenced after the draws that read it, so the CPU
+// only ever writes to a region the GPU has finished with and never waits on the
+// frame in flight.
+//
+// With ARB_buffer_storage (core in 4.4) the whole buffer is persistently mapped
+// and callers write straight into GPU-visible memory. Otherwise writes go to a
+// CPU copy that is sent with glBufferSubData when the frame is finished.
+class StreamBuffer {
+public:
+    static const int REGION_COUNT = 3;
+
+    void create(size_t regionBytes);
+    void destroy();
+
+    // Start writing a frame of `bytes`. Waits for the GPU to release the next
+    // region (growing the buffer if it is too small) and returns where to write.
+    void* beginWrite(size_t bytes);
+    // Finish the writes started by beginWrite(). Returns the byte offset of the
+    // frame's data in the buffer, for glVertexAttribPointer.
+    size_t endWrite();
+    // Call after the last draw that reads this frame's data
+    void fence();
+
+    unsigned int buffer() const { return vbo; }
+    bool persistentlyMapped() const { return mapped != nullptr; }
+
+private:
+    void allocate(size_t regionBytes);
+    void release();
+
+    unsigned int vbo = 0;
+    size_t regionSize = 0;
+    int currentRegion = 0;
+    size_t writtenBytes = 0;
+    void* fences[REGION_COUNT] = {};
+    char* mapped = nullptr; // Whole buffer when persistently mapped
+    std::vector<char> staging; // One region's worth otherwise
+};
+
+// Use glBufferSubData even when ARB_buffer_storage is available
+void setBufferStorageEnabled(bool enabled);
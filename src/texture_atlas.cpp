@@ -0,0 +1,377 @@
+#include "texture_atlas.h"
+
+#include <glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "thread_pool.h"
+#include "trace.h"
+
+// Border around every image, in pixels. Covers bilinear filtering down to the
+// last mip level the atlas keeps.
+const int ATLAS_PADDING = 8;
+const int ATLAS_MAX_MIP_LEVEL = 3;
+
+namespace {
+
+struct DecodedImage {
+    std::string name;
+    int width, height;
+    unsigned char* pixels; // RGBA, top row first
+    int x, y; // Top-left of the image (inside its border) in the atlas
+};
+
+int nextPowerOfTwo(int value) {
+    int result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+bool isImageFile(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+           extension == ".bmp" || extension == ".tga";
+}
+
+// Place images on shelves, tallest first, in an atlas `atlasWidth` wide.
+// Returns the height used.
+int packShelves(std::vector<DecodedImage>& decoded, int atlasWidth) {
+    std::vector<DecodedImage*> order;
+    for (DecodedImage& image : decoded)
+        order.push_back(&image);
+    std::sort(order.begin(), order.end(), [](const DecodedImage* a, const DecodedImage* b) {
+        return a->height != b->height ? a->height > b->height : a->name < b->name;
+    });
+
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    for (DecodedImage* image : order) {
+        int paddedWidth = image->width + 2 * ATLAS_PADDING;
+        int paddedHeight = image->height + 2 * ATLAS_PADDING;
+        if (shelfX + paddedWidth > atlasWidth) {
+            shelfY += shelfHeight;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+        image->x = shelfX + ATLAS_PADDING;
+        image->y = shelfY + ATLAS_PADDING;
+        shelfX += paddedWidth;
+        shelfHeight = std::max(shelfHeight, paddedHeight);
+    }
+    return shelfY + shelfHeight;
+}
+
+// Copy an image into the atlas and smear its edge pixels out over its border
+void blit(std::vector<unsigned char>& atlas, int atlasWidth, const DecodedImage& image) {
+    for (int row = -ATLAS_PADDING; row < image.height + ATLAS_PADDING; ++row) {
+        int sourceRow = std::min(std::max(row, 0), image.height - 1);
+        for (int column = -ATLAS_PADDING; column < image.width + ATLAS_PADDING; ++column) {
+            int sourceColumn = std::min(std::max(column, 0), image.width - 1);
+            const unsigned char* source = image.pixels + 4 * (sourceRow * image.width + sourceColumn);
+            unsigned char* target = &atlas[4 * ((image.y + row) * atlasWidth + image.x + column)];
+            std::memcpy(target, source, 4);
+        }
+    }
+}
+
+const char CACHE_MAGIC[8] = {'T', 'S', 'A', 'T', 'L', 'A', 'S', '\0'};
+const unsigned CACHE_VERSION = 1;
+const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+struct CacheHeader {
+    char magic[8];
+    unsigned version;
+    unsigned imageCount;
+    unsigned long long sourceKey; // Hash of the source files and packing settings
+    int width, height; // Size of mip level 0
+};
+
+struct CacheImage {
+    int width, height;
+    float u0, v0, u1, v1;
+    unsigned nameLength;
+};
+
+// FNV-1a, continuing from `hash`
+unsigned long long hashBytes(unsigned long long hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void readFile(const std::filesystem::path& path, std::vector<unsigned char>& contents) {
+    std::ifstream file(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+template <typename T>
+bool readPod(const unsigned char*& cursor, const unsigned char* end, T& value) {
+    if ((size_t)(end - cursor) < sizeof(T))
+        return false;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+} // namespace
+
+// Sizes and byte offsets of every mip level kept for a width x height atlas
+std::vector<TextureAtlas::MipLevel> TextureAtlas::mipChainLayout(int width, int height) {
+    std::vector<MipLevel> chain;
+    size_t offset = 0;
+    for (int level = 0; level <= ATLAS_MAX_MIP_LEVEL; ++level) {
+        chain.push_back({width, height, offset});
+        offset += chain.back().size();
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return chain;
+}
+
+// Append every smaller mip level to `pixels`, each a 2x2 box filter of the one above
+std::vector<TextureAtlas::MipLevel> TextureAtlas::buildMipChain(std::vector<unsigned char>& pixels, int width, int height) {
+    TraceZone zone("buildMipChain");
+    std::vector<MipLevel> chain = mipChainLayout(width, height);
+    pixels.resize(chain.back().offset + chain.back().size());
+    for (size_t level = 1; level < chain.size(); ++level) {
+        const MipLevel& source = chain[level - 1];
+        const MipLevel& target = chain[level];
+        for (int y = 0; y < target.height; ++y) {
+            int y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+            for (int x = 0; x < target.width; ++x) {
+                int x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+                const unsigned char* base = &pixels[source.offset];
+                unsigned char* out = &pixels[target.offset + 4 * (y * target.width + x)];
+                for (int channel = 0; channel < 4; ++channel) {
+                    int sum = base[4 * (y0 * source.width + x0) + channel] + base[4 * (y0 * source.width + x1) + channel] +
+                              base[4 * (y1 * source.width + x0) + channel] + base[4 * (y1 * source.width + x1) + channel];
+                    out[channel] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+    return chain;
+}
+
+void TextureAtlas::beginLoad(const std::string& directory, const std::string& cacheFile, unsigned threadCount) {
+    destroy();
+    loader = std::thread(&TextureAtlas::decodeAndPack, this, directory, cacheFile, threadCount);
+}
+
+// Runs on the loader thread; touches no GL state
+void TextureAtlas::decodeAndPack(const std::string& directory, const std::string& cacheFile, unsigned threadCount) {
+    setTraceThreadName("atlas loader");
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (entry.is_regular_file() && isImageFile(entry.path()))
+            files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    // Reading and hashing the compressed files is cheap next to decoding them,
+    // and the hash decides whether decoding is needed at all
+    std::vector<std::vector<unsigned char>> sources(files.size());
+    ThreadPool pool(std::max(1u, std::min(threadCount, (unsigned)files.size())));
+    pool.parallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            readFile(files[i], sources[i]);
+    });
+    unsigned long long key = hashBytes(FNV_OFFSET_BASIS, &CACHE_VERSION, sizeof(CACHE_VERSION));
+    key = hashBytes(key, &ATLAS_PADDING, sizeof(ATLAS_PADDING));
+    key = hashBytes(key, &ATLAS_MAX_MIP_LEVEL, sizeof(ATLAS_MAX_MIP_LEVEL));
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string name = files[i].filename().string();
+        key = hashBytes(key, name.data(), name.size() + 1);
+        key = hashBytes(key, sources[i].data(), sources[i].size());
+    }
+
+    if (!cacheFile.empty() && readCache(cacheFile, key))
+        return;
+
+    // PNG decoding dominates, and every file is independent
+    std::vector<DecodedImage> loaded(files.size());
+    pool.parallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int components;
+            loaded[i].name = files[i].stem().string();
+            loaded[i].pixels = stbi_load_from_memory(sources[i].data(), (int)sources[i].size(),
+                                                     &loaded[i].width, &loaded[i].height, &components, 4);
+        }
+    });
+    sources.clear();
+
+    std::vector<DecodedImage> decoded;
+    long long area = 0;
+    int widest = 0;
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        if (!loaded[i].pixels) {
+            std::cout << "Texture failed to load at path: " << files[i].string() << std::endl;
+            continue;
+        }
+        decoded.push_back(loaded[i]);
+        area += (long long)(loaded[i].width + 2 * ATLAS_PADDING) * (loaded[i].height + 2 * ATLAS_PADDING);
+        widest = std::max(widest, loaded[i].width + 2 * ATLAS_PADDING);
+    }
+    if (decoded.empty()) {
+        std::cout << "No images found in " << directory << std::endl;
+        return;
+    }
+
+    // Roughly square, but never narrower than the widest image
+    int atlasWidth = nextPowerOfTwo(std::max(widest, (int)std::ceil(std::sqrt((double)area))));
+    int atlasHeight = nextPowerOfTwo(packShelves(decoded, atlasWidth));
+
+    pixels.assign((size_t)atlasWidth * atlasHeight * 4, 0);
+    for (DecodedImage& image : decoded) {
+        blit(pixels, atlasWidth, image);
+        images.push_back({image.name, image.width, image.height,
+                          (float)image.x / atlasWidth, (float)image.y / atlasHeight,
+                          (float)(image.x + image.width) / atlasWidth,
+                          (float)(image.y + image.height) / atlasHeight});
+        stbi_image_free(image.pixels);
+    }
+    levels = buildMipChain(pixels, atlasWidth, atlasHeight);
+    levelData = pixels.data();
+
+    if (!cacheFile.empty())
+        writeCache(cacheFile, key);
+}
+
+// Cache layout: CacheHeader, then per image its CacheImage followed by its name,
+// then every mip level's RGBA pixels back to back, largest first
+bool TextureAtlas::readCache(const std::string& cacheFile, unsigned long long key) {
+    TraceZone zone("readAtlasCache");
+    if (!cache.open(cacheFile.c_str()))
+        return false;
+
+    const unsigned char* cursor = cache.data();
+    const unsigned char* end = cache.data() + cache.size();
+    CacheHeader header;
+    if (!readPod(cursor, end, header) || std::memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CACHE_VERSION || header.sourceKey != key) {
+        cache.close();
+        return false;
+    }
+
+    std::vector<AtlasImage> cached;
+    for (unsigned i = 0; i < header.imageCount; ++i) {
+        CacheImage entry;
+        if (!readPod(cursor, end, entry) || (size_t)(end - cursor) < entry.nameLength) {
+            cache.close();
+            return false;
+        }
+        std::string name((const char*)cursor, entry.nameLength);
+        cursor += entry.nameLength;
+        cached.push_back({name, entry.width, entry.height, entry.u0, entry.v0, entry.u1, entry.v1});
+    }
+
+    std::vector<MipLevel> chain = mipChainLayout(header.width, header.height);
+    size_t pixelBytes = chain.back().offset + chain.back().size();
+    if ((size_t)(end - cursor) != pixelBytes) {
+        cache.close();
+        return false;
+    }
+
+    images = cached;
+    levels = chain;
+    levelData = cursor; // Straight out of the mapping; the OS pages it in as GL reads it
+    return true;
+}
+
+void TextureAtlas::writeCache(const std::string& cacheFile, unsigned long long key) const {
+    TraceZone zone("writeAtlasCache");
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.imageCount = (unsigned)images.size();
+    header.sourceKey = key;
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+
+    // Write next to the final name and swap it in, so a crash never leaves a torn cache
+    std::string temporary = cacheFile + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "Could not write texture cache " << cacheFile << std::endl;
+        return;
+    }
+    out.write((const char*)&header, sizeof(header));
+    for (const AtlasImage& image : images) {
+        CacheImage entry = {image.width, image.height, image.u0, image.v0, image.u1, image.v1,
+                            (unsigned)image.name.size()};
+        out.write((const char*)&entry, sizeof(entry));
+        out.write(image.name.data(), image.name.size());
+    }
+    out.write((const char*)levelData, levels.back().offset + levels.back().size());
+    out.close();
+
+    std::error_code error;
+    std::filesystem::remove(cacheFile, error);
+    std::filesystem::rename(temporary, cacheFile, error);
+    if (!out || error)
+        std::cout << "Could not write texture cache " << cacheFile << std::endl;
+}
+
+bool TextureAtlas::finishLoad() {
+    if (loader.joinable())
+        loader.join();
+    if (images.empty())
+        return false;
+
+    TraceZone zone("uploadAtlas");
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // Every level is precomputed, so the driver does no filtering work here
+    for (size_t level = 0; level < levels.size(); ++level) {
+        glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, levels[level].width, levels[level].height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, levelData + levels[level].offset);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // The driver has its own copy now
+    std::vector<unsigned char>().swap(pixels);
+    cache.close();
+    levelData = nullptr;
+    return true;
+}
+
+void TextureAtlas::destroy() {
+    if (loader.joinable())
+        loader.join();
+    if (textureId)
+        glDeleteTextures(1, &textureId);
+    textureId = 0;
+    images.clear();
+    levels.clear();
+    pixels.clear();
+    cache.close();
+    levelData = nullptr;
+}
+
+const AtlasImage* TextureAtlas::find(const std::string& name) const {
+    for (const AtlasImage& image : images) {
+        if (image.name == name)
+            return &image;
+    }
+    return nullptr;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Where one source image ended up in the atlas
+struct AtlasImage {
+    std::string name; // File name without directory or extension, e.g. "Traffic-1"
+    int width, height; // Size of the source image in pixels
+    float u0, v0, u1, v1; // Texture coordinates of its top-left and bottom-right corners
+};
+
+// All images of a directory packed into one RGBA texture, so everything textured
+// can be drawn with a single bind. Images are placed on shelves sorted by height,
+// each with a border of repeated edge pixels so filtering and the smaller mip
+// levels never pick up a neighbour.
+class TextureAtlas {
+public:
+    ~TextureAtlas() {
+        if (loader.joinable())
+            loader.join();
+    }
+
+    // Decode every .png/.jpg/.bmp/.tga in `directory` and pack them, on worker
+    // threads. Needs no GL context, so it can run while the window comes up.
+    // The packed atlas and its mip chain are saved to `cacheFile` (unless empty);
+    // while the source images are unchanged, later loads map that file instead
+    // of decoding anything.
+    void beginLoad(const std::string& directory, const std::string& cacheFile, unsigned threadCount);
+    // Wait for beginLoad() and upload the texture. Needs a current GL context.
+    // Returns false if nothing could be loaded.
+    bool finishLoad();
+    void destroy();
+
+    // The image with the given name, or nullptr if the directory had none
+    const AtlasImage* find(const std::string& name) const;
+
+    unsigned int texture() const { return textureId; }
+
+private:
+    struct MipLevel {
+        int width, height;
+        size_t offset; // Bytes from the start of level 0
+        size_t size() const { return (size_t)width * height * 4; }
+    };
+
+    void decodeAndPack(const std::string& directory, const std::string& cacheFile, unsigned threadCount);
+    bool readCache(const std::string& cacheFile, unsigned long long key);
+    void writeCache(const std::string& cacheFile, unsigned long long key) const;
+    static std::vector<MipLevel> mipChainLayout(int width, int height);
+    static std::vector<MipLevel> buildMipChain(std::vector<unsigned char>& pixels, int width, int height);
+
+    std::vector<AtlasImage> images;
+    unsigned int textureId = 0;
+
+    // Filled by the loader thread, then handed to GL by finishLoad()
+    std::thread loader;
+    std::vector<MipLevel> levels;
+    const unsigned char* levelData = nullptr; // Points into `pixels` or `cache`
+    std::vector<unsigned char> pixels;
+    MappedFile cache;
+};
@@ -0,0 +1,111 @@
+#include "thread_pool.h"
+
+#include "trace.h"
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = 1;
+    for (unsigned i = 0; i < threadCount; ++i)
+        queues.emplace_back(new WorkQueue());
+    for (unsigned i = 1; i < threadCount; ++i)
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const RangeBody& body) {
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    // Not worth waking anyone for a single chunk
+    if (count <= grain || queues.size() == 1) {
+        body(0, count);
+        return;
+    }
+
+    // Deal the chunks out round-robin so every worker starts with local work
+    size_t taskCount = (count + grain - 1) / grain;
+    remainingTasks.store(taskCount);
+    for (size_t t = 0; t < taskCount; ++t) {
+        size_t begin = t * grain;
+        size_t end = begin + grain < count ? begin + grain : count;
+        WorkQueue& queue = *queues[t % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back({begin, end, &body});
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        ++jobGeneration;
+    }
+    jobReady.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(jobMutex);
+    jobDone.wait(lock, [this] { return remainingTasks.load() == 0; });
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    setTraceThreadName("pool worker");
+    unsigned long long seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            jobReady.wait(lock, [&] { return stopping || jobGeneration != seenGeneration; });
+            if (stopping)
+                return;
+            seenGeneration = jobGeneration;
+        }
+        runTasks(index);
+    }
+}
+
+// Run tasks until every queue is empty. Each task carries its own body, so a
+// worker that wakes late can never run one job's chunk with another job's body.
+void ThreadPool::runTasks(unsigned index) {
+    Task task;
+    while (popLocal(index, task) || steal(index, task)) {
+        {
+            TraceZone zone("task");
+            (*task.body)(task.begin, task.end);
+        }
+        if (remainingTasks.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobDone.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popLocal(unsigned index, Task& task) {
+    WorkQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+        return false;
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned index, Task& task) {
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+        WorkQueue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. Each parallelFor() splits
+// its range into chunks that are dealt out to per-worker queues; a worker drains
+// its own queue from the back and steals from the front of the others' queues
+// once it runs dry, so uneven chunks still finish together.
+class ThreadPool {
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeBody;
+
+    // `threadCount` includes the calling thread, which works during parallelFor()
+    explicit ThreadPool(unsigned threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)queues.size(); }
+
+    // Call body(begin, end) over [0, count) in chunks of at most `grain` items
+    // and return once every chunk has finished
+    void parallelFor(size_t count, size_t grain, const RangeBody& body);
+
+private:
+    struct Task {
+        size_t begin, end;
+        const RangeBody* body;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    void runTasks(unsigned index);
+    bool popLocal(unsigned index, Task& task);
+    bool steal(unsigned index, Task& task);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues; // queues[0] belongs to the caller
+    std::vector<std::thread> threads;
+
+    std::mutex jobMutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    unsigned long long jobGeneration = 0;
+    bool stopping = false;
+    std::atomic<size_t> remainingTasks{0};
+};
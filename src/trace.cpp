@@ -0,0 +1,110 @@
+#include "trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> tracingActive{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    long long start, end; // Nanoseconds since startTracing()
+};
+
+// Written only by its own thread. `written` is published after each event, so
+// the reader never sees a slot before it has been filled.
+struct TraceRing {
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(TRACE_EVENTS_PER_THREAD);
+    std::atomic<unsigned long long> written{0};
+    const char* threadName = nullptr;
+    int id = 0;
+};
+
+std::chrono::steady_clock::time_point traceStart;
+
+// Every ring ever created; kept after its thread exits so its zones are still written
+std::mutex ringsMutex;
+std::vector<std::unique_ptr<TraceRing>> rings;
+
+thread_local TraceRing* threadRing = nullptr;
+thread_local const char* threadName = nullptr;
+
+TraceRing* createRing() {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.emplace_back(new TraceRing());
+    rings.back()->id = (int)rings.size();
+    rings.back()->threadName = threadName;
+    return rings.back().get();
+}
+
+} // namespace
+
+void startTracing() {
+    traceStart = std::chrono::steady_clock::now();
+    tracingActive.store(true);
+}
+
+long long traceNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+void setTraceThreadName(const char* name) {
+    threadName = name;
+    if (threadRing)
+        threadRing->threadName = name;
+}
+
+void recordTraceZone(const char* name, long long start, long long end) {
+    if (!threadRing)
+        threadRing = createRing();
+    unsigned long long index = threadRing->written.load(std::memory_order_relaxed);
+    threadRing->events[index % TRACE_EVENTS_PER_THREAD] = {name, start, end};
+    threadRing->written.store(index + 1, std::memory_order_release);
+}
+
+bool writeTrace(const std::string& path) {
+    tracingActive.store(false);
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cout << "Could not write trace " << path << std::endl;
+        return false;
+    }
+
+    // Complete ("X") events, with microsecond timestamps as the format expects
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t eventCount = 0;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (const auto& ring : rings) {
+        if (ring->threadName) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id
+                << ",\"args\":{\"name\":\"" << ring->threadName << "\"}}";
+            first = false;
+        }
+        unsigned long long written = ring->written.load(std::memory_order_acquire);
+        unsigned long long begin = written > TRACE_EVENTS_PER_THREAD ? written - TRACE_EVENTS_PER_THREAD : 0;
+        for (unsigned long long i = begin; i < written; ++i) {
+            const TraceEvent& event = ring->events[i % TRACE_EVENTS_PER_THREAD];
+            out << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id
+                << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+            first = false;
+        }
+        eventCount += written - begin;
+    }
+    out << "\n]}\n";
+
+    if (!out) {
+        std::cout << "Could not write trace " << path << std::endl;
+        return false;
+    }
+    std::cout << "Wrote " << eventCount << " trace zones to " << path << std::endl;
+    return true;
+}
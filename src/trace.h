@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+// Timeline of named zones on every thread, saved as Chrome trace-event JSON that
+// opens in chrome://tracing or ui.perfetto.dev. Each thread appends to its own
+// ring of the most recent TRACE_EVENTS_PER_THREAD zones without taking a lock.
+// Until startTracing() a zone costs one relaxed atomic load.
+
+const size_t TRACE_EVENTS_PER_THREAD = 1 << 18;
+
+extern std::atomic<bool> tracingActive;
+
+void startTracing();
+// Write every thread's buffered zones to `path`. Call once the traced threads
+// have stopped or are idle.
+bool writeTrace(const std::string& path);
+// Label the calling thread in the trace; `name` must outlive the program (a literal)
+void setTraceThreadName(const char* name);
+
+// Nanoseconds on the trace clock
+long long traceNow();
+void recordTraceZone(const char* name, long long start, long long end);
+
+// Records the enclosing block as a zone called `name` (a string literal)
+class TraceZone {
+public:
+    explicit TraceZone(const char* name) : name(tracingActive.load(std::memory_order_relaxed) ? name : nullptr) {
+        if (this->name)
+            start = traceNow();
+    }
+    ~TraceZone() {
+        if (name)
+            recordTraceZone(name, start, traceNow());
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+    const char* name;
+    long long start = 0;
+};
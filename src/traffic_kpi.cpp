@@ -0,0 +1,117 @@
+#include "traffic_kpi.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "simulation.h"
+
+// Larger networks only get the totals on the console
+const size_t MAX_LISTED_APPROACHES = 8;
+
+namespace {
+
+struct ApproachSummary {
+    int lane;
+    const char* heading;
+    float stopX, stopY; // World position of the stop line
+    double minutes;
+    double dischargedPerMinute;
+    double delayPerVehicle; // Seconds
+    double meanQueue;
+    int maxQueue;
+};
+
+const char* headingOf(const Lane& lane) {
+    if (lane.directionX > 0.5f)
+        return "eastbound";
+    if (lane.directionX < -0.5f)
+        return "westbound";
+    return lane.directionY > 0.0f ? "northbound" : "southbound";
+}
+
+std::vector<ApproachSummary> summarizeApproaches() {
+    std::vector<ApproachSummary> approaches;
+    for (size_t l = 0; l < lanes.size(); ++l) {
+        const Lane& lane = lanes[l];
+        if (lane.signal < 0)
+            continue;
+        const ApproachStats& stats = lane.stats;
+        ApproachSummary summary;
+        summary.lane = (int)l;
+        summary.heading = headingOf(lane);
+        summary.stopX = lane.originX + lane.directionX * lane.stopLine;
+        summary.stopY = lane.originY + lane.directionY * lane.stopLine;
+        summary.minutes = stats.steps * SIM_DT / 60.0;
+        summary.dischargedPerMinute = summary.minutes > 0.0 ? stats.discharged / summary.minutes : 0.0;
+        summary.delayPerVehicle = stats.discharged > 0 ? stats.delaySteps * SIM_DT / stats.discharged : 0.0;
+        summary.meanQueue = stats.steps > 0 ? (double)stats.queuedCarSteps / stats.steps : 0.0;
+        summary.maxQueue = stats.maxQueue;
+        approaches.push_back(summary);
+    }
+    return approaches;
+}
+
+// Delay is left blank for an approach nothing has left yet (e.g. held on red)
+void printRow(const char* name, const ApproachSummary& row, bool hasDischarges) {
+    char delay[32] = "-";
+    if (hasDischarges)
+        std::snprintf(delay, sizeof(delay), "%.2f", row.delayPerVehicle);
+    std::printf("  %-28s %14.1f %14s %11.2f %10d\n", name, row.dischargedPerMinute, delay, row.meanQueue, row.maxQueue);
+}
+
+} // namespace
+
+void printTrafficSummary() {
+    std::vector<ApproachSummary> approaches = summarizeApproaches();
+    if (approaches.empty())
+        return;
+
+    // Network totals: discharges add up, delay is per vehicle over all of them,
+    // the mean queue is per approach
+    ApproachSummary total = {};
+    long long discharged = 0;
+    double delaySteps = 0.0;
+    for (const ApproachSummary& approach : approaches) {
+        const ApproachStats& stats = lanes[approach.lane].stats;
+        discharged += stats.discharged;
+        delaySteps += stats.delaySteps;
+        total.dischargedPerMinute += approach.dischargedPerMinute;
+        total.meanQueue += approach.meanQueue / approaches.size();
+        total.maxQueue = std::max(total.maxQueue, approach.maxQueue);
+    }
+    total.delayPerVehicle = discharged > 0 ? delaySteps * SIM_DT / discharged : 0.0;
+
+    std::printf("Traffic over %.1f simulated seconds, %zu approaches:\n", approaches[0].minutes * 60.0, approaches.size());
+    std::printf("  %-28s %14s %14s %11s %10s\n", "approach", "discharged/min", "delay/veh (s)", "mean queue", "max queue");
+    if (approaches.size() <= MAX_LISTED_APPROACHES) {
+        for (const ApproachSummary& approach : approaches) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s at (%.2f, %.2f)", approach.heading, approach.stopX, approach.stopY);
+            printRow(name, approach, lanes[approach.lane].stats.discharged > 0);
+        }
+    }
+    printRow("all approaches", total, discharged > 0);
+    std::fflush(stdout);
+}
+
+bool writeTrafficCsv(const std::string& path) {
+    std::ofstream csv(path, std::ios::trunc);
+    if (!csv) {
+        std::cout << "Could not write traffic file " << path << std::endl;
+        return false;
+    }
+    csv << "lane,heading,stop_x,stop_y,simulated_s,discharged,discharged_per_min,delay_per_vehicle_s,mean_queue,max_queue\n";
+    for (const ApproachSummary& approach : summarizeApproaches()) {
+        csv << approach.lane << ',' << approach.heading << ',' << approach.stopX << ',' << approach.stopY << ','
+            << approach.minutes * 60.0 << ',' << lanes[approach.lane].stats.discharged << ','
+            << approach.dischargedPerMinute << ',';
+        if (lanes[approach.lane].stats.discharged > 0)
+            csv << approach.delayPerVehicle;
+        csv << ',' << approach.meanQueue << ','
+            << approach.maxQueue << '\n';
+    }
+    return (bool)csv;
+}
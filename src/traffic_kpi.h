@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+// Reports on the ApproachStats every signalled lane collects as it is updated.
+// Delay per vehicle is the mean, over the cars that drove over an approach's
+// stop line, of the time they took to get there beyond their free-flow time.
+// Free-flow time includes speeding up from the speed a car entered the lane
+// at, so cars that spawn at standstill are not charged for getting going.
+
+// Print a table of every approach (or just the totals for large networks)
+void printTrafficSummary();
+// Write one CSV row per approach to `path`
+bool writeTrafficCsv(const std::string& path);